@@ -0,0 +1,233 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "BackgroundLayout.h"
+
+#include <cstring>
+
+// QtCore
+#include <QtCore/QAtomicInt>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+#include <QtCore/QTimerEvent>
+
+#include "DistanceMatrix.h"
+#include "Graph.h"
+#include "GraphCore.h"
+#include "KamadaKawaiLayout.h"
+#include "WorkerPool.h"
+
+/* Copies @p from into @p to, reusing the memory of @p to */
+static void copyInto( const QVector<qreal> &from, QVector<qreal> *to )
+{
+	to->resize( from.size() );
+	if( !from.isEmpty() )
+		memcpy( to->data(), from.constData(), from.size() * sizeof(qreal) );
+}
+
+LayoutFrames::LayoutFrames()
+{
+	m_iteration[0] = m_iteration[1] = 0;
+	m_finished[0] = m_finished[1] = false;
+	m_front = 0;
+	m_fresh = false;
+}
+
+void LayoutFrames::publish( const QVector<qreal> &x, const QVector<qreal> &y,
+                            int iteration, bool finished )
+{
+	//only this thread changes m_front, so the back buffer is ours until
+	//the swap
+	int back = 1 - m_front;
+	copyInto( x, &m_x[back] );
+	copyInto( y, &m_y[back] );
+	m_iteration[back] = iteration;
+	m_finished[back] = finished;
+	QMutexLocker lock( &m_mutex );
+	m_front = back;
+	m_fresh = true;
+}
+
+bool LayoutFrames::take( QVector<qreal> *x, QVector<qreal> *y,
+                         int *iteration, bool *finished )
+{
+	QMutexLocker lock( &m_mutex );
+	if( !m_fresh )
+		return false;
+	copyInto( m_x[m_front], x );
+	copyInto( m_y[m_front], y );
+	*iteration = m_iteration[m_front];
+	*finished = m_finished[m_front];
+	m_fresh = false;
+	return true;
+}
+
+/* Runs a Kamada-Kawai layout on a copy of the graph and publishes a frame
+ * every interval milliseconds, and one at the end */
+class LayoutThread : public QThread
+{
+public:
+	LayoutThread( const GraphCore &core, LayoutFrames *frames, int maxiter,
+	              qreal epsilon, qreal theta, int threads,
+	              DistanceMatrix::Storage storage, int interval )
+	    : m_core( core ), m_frames( frames ), m_maxiter( maxiter ),
+	      m_epsilon( epsilon ), m_theta( theta ), m_threads( threads ),
+	      m_storage( storage ), m_interval( interval ), m_stop( 0 ) {}
+
+	/** asks the layout to publish its last frame and return */
+	void stop() { m_stop = 1; }
+
+protected:
+	void run();
+
+private:
+	GraphCore m_core;
+	LayoutFrames *m_frames;
+	int m_maxiter;
+	qreal m_epsilon;
+	qreal m_theta;
+	int m_threads;
+	DistanceMatrix::Storage m_storage;
+	int m_interval;
+	QAtomicInt m_stop;
+};
+
+void LayoutThread::run()
+{
+	DistanceMatrix distances;
+	//too large a graph stays where it is
+	if( !distances.compute( m_core.adjacency(), m_storage, m_threads ) ) {
+		m_frames->publish( m_core.xs(), m_core.ys(), 0, true );
+		return;
+	}
+	WorkerPool pool( m_threads );
+	KamadaKawaiLayout kk( m_core.xs(), m_core.ys(), &distances, &pool,
+	                      m_theta );
+	QElapsedTimer clock;
+	clock.start();
+	int iteration = 0;
+	while( iteration < m_maxiter && !m_stop && kk.size() > 0 ) {
+		int m = kk.maxVertex();
+		qreal dx, dy;
+		kk.newtonStep( m, &dx, &dy );
+		kk.move( m, dx, dy );
+		++iteration;
+		//the stop rule of Graph::layoutKamadaKawai(), for the same result
+		if( qAbs( kk.delta_m( m ) ) < m_epsilon )
+			break;
+		if( clock.elapsed() >= m_interval ) {
+			m_frames->publish( kk.x(), kk.y(), iteration, false );
+			clock.start();
+		}
+	}
+	m_frames->publish( kk.x(), kk.y(), iteration, true );
+}
+
+BackgroundLayout::BackgroundLayout( Graph *g, QObject *parent )
+    : QObject( parent )
+{
+	m_graph = g;
+	m_thread = 0;
+	m_timer = 0;
+	m_fps = 30;
+	m_iteration = 0;
+}
+
+BackgroundLayout::~BackgroundLayout()
+{
+	stop();
+}
+
+void BackgroundLayout::setFrameRate( int fps )
+{
+	m_fps = qMax( 1, fps );
+}
+
+int BackgroundLayout::frameRate() const
+{
+	return m_fps;
+}
+
+void BackgroundLayout::startKamadaKawai( int maxiter, qreal epsilon,
+                                         bool initialize )
+{
+	stop();
+	if( initialize )
+		m_graph->layoutRandom( 100.0 );
+	if( maxiter < 0 )
+		maxiter = 65536;
+	//frames published faster than they are shown would only be copied
+	m_thread = new LayoutThread( *m_graph->core(), &m_frames, maxiter,
+	                             epsilon, m_graph->repulsionTheta(),
+	                             m_graph->layoutThreads(),
+	                             m_graph->distanceStorage(), 1000 / m_fps );
+	m_iteration = 0;
+	m_thread->start( QThread::LowPriority );
+	m_timer = startTimer( 1000 / m_fps );
+}
+
+void BackgroundLayout::stop()
+{
+	if( !m_thread )
+		return;
+	m_thread->stop();
+	m_thread->wait();
+	//the thread always publishes a last frame
+	applyFrame();
+	finish();
+}
+
+bool BackgroundLayout::isRunning() const
+{
+	return m_thread != 0;
+}
+
+int BackgroundLayout::iteration() const
+{
+	return m_iteration;
+}
+
+void BackgroundLayout::timerEvent( QTimerEvent *event )
+{
+	if( event->timerId() != m_timer ) {
+		QObject::timerEvent( event );
+		return;
+	}
+	if( m_thread && !applyFrame() )
+		finish();
+}
+
+void BackgroundLayout::frameApplied( bool finished )
+{
+	Q_UNUSED( finished );
+}
+
+bool BackgroundLayout::applyFrame()
+{
+	bool finished = false;
+	if( !m_frames.take( &m_x, &m_y, &m_iteration, &finished ) )
+		return true;
+	GraphCore *core = m_graph->core();
+	if( m_x.size() == core->size() ) {
+		core->setPositions( m_x, m_y );
+		m_graph->updateItems();
+	}
+	frameApplied( finished );
+	return !finished;
+}
+
+void BackgroundLayout::finish()
+{
+	m_thread->wait();
+	delete m_thread;
+	m_thread = 0;
+	killTimer( m_timer );
+	m_timer = 0;
+}
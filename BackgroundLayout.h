@@ -0,0 +1,118 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef BACKGROUNDLAYOUT_H
+#define BACKGROUNDLAYOUT_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QVector>
+
+class QTimerEvent;
+
+class Graph;
+class LayoutThread;
+
+/**
+ * @brief Hands vertex positions from a layout thread to the GUI thread
+ *
+ * There are two buffers. The layout thread fills the back one without
+ * holding the lock and swaps it to the front; the GUI thread copies the
+ * front one out under the lock. Neither side waits for more than a copy.
+ */
+class LayoutFrames
+{
+public:
+	LayoutFrames();
+
+	/**
+	 * Publishes the positions after @p iteration steps, called by the
+	 * layout thread
+	 * @param finished true for the last frame of the layout
+	 */
+	void publish( const QVector<qreal> &x, const QVector<qreal> &y,
+	              int iteration, bool finished );
+	/**
+	 * Takes the newest frame if it hasn't been taken yet, called by the
+	 * GUI thread
+	 * @return false if there is no new frame, the arguments are left alone
+	 */
+	bool take( QVector<qreal> *x, QVector<qreal> *y, int *iteration,
+	           bool *finished );
+
+private:
+	QMutex m_mutex;
+	QVector<qreal> m_x[2];
+	QVector<qreal> m_y[2];
+	int m_iteration[2];
+	bool m_finished[2];
+	/// the buffer take() reads, the other one belongs to publish()
+	int m_front;
+	bool m_fresh;
+};
+
+/**
+ * @brief Lays out a graph on a thread of its own while the GUI goes on
+ *
+ * The layout works on a snapshot of the positions and edges. Every so
+ * often it publishes the positions through LayoutFrames, and a timer on
+ * the GUI thread applies the newest frame to all items in one go, at most
+ * frameRate() times per second. The graph must not gain or lose vertices
+ * or edges until the layout is finished or stopped.
+ *
+ * This needs an event loop on the thread that made it.
+ */
+class BackgroundLayout : public QObject
+{
+public:
+	BackgroundLayout( Graph *g, QObject *parent = 0 );
+	/** Stops the layout, the vertices keep the last frame applied */
+	~BackgroundLayout();
+
+	/** Sets how many frames per second are applied at most, 30 by default */
+	void setFrameRate( int fps );
+	int frameRate() const;
+
+	/**
+	 * Starts a Kamada-Kawai layout and returns at once. The threads, the
+	 * repulsion, the distance storage and the random seed are taken from
+	 * the graph, and it stops by the same rule, so the final frame is what
+	 * Graph::layoutKamadaKawai() would give.
+	 */
+	void startKamadaKawai( int maxiter, qreal epsilon, bool initialize );
+	/** Stops the layout and applies its last frame */
+	void stop();
+	/** @return true until the last frame of the layout has been applied */
+	bool isRunning() const;
+	/** @return the number of steps done in the last frame applied */
+	int iteration() const;
+
+protected:
+	void timerEvent( QTimerEvent *event );
+	/**
+	 * Called after a frame has been applied to the graph, does nothing
+	 * @param finished true for the last one
+	 */
+	virtual void frameApplied( bool finished );
+
+private:
+	/** applies the newest frame, @return false once the last one is in */
+	bool applyFrame();
+	void finish();
+
+	Graph *m_graph;
+	LayoutFrames m_frames;
+	LayoutThread *m_thread;
+	int m_timer;
+	int m_fps;
+	int m_iteration;
+	QVector<qreal> m_x;
+	QVector<qreal> m_y;
+};
+
+#endif //include guard
@@ -0,0 +1,339 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "BinaryGraph.h"
+
+// C
+#include <cstring>
+
+// QtCore
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+
+#include "GraphCore.h"
+
+// the first bytes of every graph file
+static const char MAGIC[8] = { 'K', 'F', 'B', 'G', 'R', 'A', 'P', 'H' };
+// reads back as something else on a machine of the other byte order
+static const quint32 BYTEORDER = 0x01020304;
+
+struct BinaryGraph::Header {
+	char magic[8];
+	quint32 version;
+	quint32 byteOrder;
+	quint32 vertexCount;
+	quint32 edgeCount;
+	/// the offsets of the arrays from the start of the file
+	quint64 ids, x, y, labelOffsets, labels, rows, neighbours, weights;
+	quint64 heads, tails, edgeWeights;
+	quint64 fileSize;
+};
+
+static inline quint64 align( quint64 offset )
+{
+	return ( offset + 7 ) & ~Q_UINT64_C( 7 );
+}
+
+BinaryGraph::BinaryGraph()
+{
+	m_file = 0;
+	m_data = 0;
+	m_header = 0;
+}
+
+BinaryGraph::~BinaryGraph()
+{
+	close();
+}
+
+template<class T>
+inline const T* BinaryGraph::section( quint64 offset ) const
+{
+	return reinterpret_cast<const T*>( m_data + offset );
+}
+
+bool BinaryGraph::open( const QString &fileName )
+{
+	close();
+	m_file = new QFile( fileName );
+	if( !m_file->open( QIODevice::ReadOnly ) ) {
+		m_error = fileName + ": " + m_file->errorString();
+		close();
+		return false;
+	}
+	quint64 size = m_file->size();
+	if( size < sizeof(Header) ) {
+		m_error = fileName + ": too short for a graph file";
+		close();
+		return false;
+	}
+	m_data = m_file->map( 0, size );
+	if( !m_data ) {
+		m_error = fileName + ": can't be mapped";
+		close();
+		return false;
+	}
+
+	const Header *h = reinterpret_cast<const Header*>( m_data );
+	QString error;
+	if( memcmp( h->magic, MAGIC, sizeof(MAGIC) ) != 0 )
+		error = "not a graph file";
+	else if( h->byteOrder != BYTEORDER )
+		error = "written on a machine of the other byte order";
+	else if( h->version != VERSION )
+		error = QString("version %1 is not supported").arg( h->version );
+	else if( h->fileSize != size )
+		error = "truncated";
+	if( error.isEmpty() ) {
+		//every array has to be aligned and inside the file
+		quint64 n = h->vertexCount;
+		quint64 m = h->edgeCount;
+		quint64 entries = 2 * m;
+		const quint64 starts[] = { h->ids, h->x, h->y, h->labelOffsets,
+		                           h->labels, h->rows, h->neighbours,
+		                           h->weights, h->heads, h->tails,
+		                           h->edgeWeights };
+		const quint64 lengths[] = { 4 * n, 8 * n, 8 * n, 8 * ( n + 1 ), 0,
+		                            8 * ( n + 1 ), 4 * entries, 8 * entries,
+		                            4 * m, 4 * m, 8 * m };
+		for(int s = 0; s < 11 && error.isEmpty(); ++s)
+			if( starts[s] % 8 != 0 || starts[s] > size
+			    || lengths[s] > size - starts[s] )
+				error = "corrupt header";
+		if( error.isEmpty() ) {
+			const quint64 *labelOffsets = section<quint64>( h->labelOffsets );
+			const quint64 *rows = section<quint64>( h->rows );
+			if( labelOffsets[0] != 0 || labelOffsets[n] > size - h->labels
+			    || rows[0] != 0 || rows[n] != entries )
+				error = "corrupt header";
+		}
+	}
+	if( !error.isEmpty() ) {
+		m_error = fileName + ": " + error;
+		close();
+		return false;
+	}
+	m_header = h;
+	return true;
+}
+
+void BinaryGraph::close()
+{
+	if( m_file && m_data )
+		m_file->unmap( m_data );
+	delete m_file;
+	m_file = 0;
+	m_data = 0;
+	m_header = 0;
+}
+
+bool BinaryGraph::isOpen() const
+{
+	return m_header != 0;
+}
+
+QString BinaryGraph::errorString() const
+{
+	return m_error;
+}
+
+int BinaryGraph::size() const
+{
+	return m_header ? m_header->vertexCount : 0;
+}
+
+int BinaryGraph::edgeCount() const
+{
+	return m_header ? m_header->edgeCount : 0;
+}
+
+const quint32* BinaryGraph::ids() const
+{
+	return section<quint32>( m_header->ids );
+}
+
+const double* BinaryGraph::xs() const
+{
+	return section<double>( m_header->x );
+}
+
+const double* BinaryGraph::ys() const
+{
+	return section<double>( m_header->y );
+}
+
+QString BinaryGraph::label( int i ) const
+{
+	const quint64 *offsets = section<quint64>( m_header->labelOffsets );
+	return QString::fromUtf8( section<char>( m_header->labels ) + offsets[i],
+	                          offsets[i+1] - offsets[i] );
+}
+
+const quint64* BinaryGraph::offsets() const
+{
+	return section<quint64>( m_header->rows );
+}
+
+const quint32* BinaryGraph::neighbours() const
+{
+	return section<quint32>( m_header->neighbours );
+}
+
+const double* BinaryGraph::weights() const
+{
+	return section<double>( m_header->weights );
+}
+
+const quint32* BinaryGraph::heads() const
+{
+	return section<quint32>( m_header->heads );
+}
+
+const quint32* BinaryGraph::tails() const
+{
+	return section<quint32>( m_header->tails );
+}
+
+const double* BinaryGraph::edgeWeights() const
+{
+	return section<double>( m_header->edgeWeights );
+}
+
+bool BinaryGraph::load( GraphCore *core, QVector<QString> *labels )
+{
+	Q_ASSERT( core->size() == 0 );
+	int n = size();
+	int m = edgeCount();
+	/* open() only checked the ends of the labels, everything in between
+	 * is indexed below; the rows are not used here */
+	const quint64 *labelOffsets = section<quint64>( m_header->labelOffsets );
+	for(int i = 0; i < n; ++i)
+		if( labelOffsets[i] > labelOffsets[i+1] ) {
+			m_error = "corrupt offsets";
+			return false;
+		}
+	const quint32 *heads = this->heads();
+	const quint32 *tails = this->tails();
+	for(int e = 0; e < m; ++e)
+		if( heads[e] >= (quint32)n || tails[e] >= (quint32)n ) {
+			m_error = "corrupt edges";
+			return false;
+		}
+
+	if( !core->assign( n, ids(), xs(), ys(), m, heads, tails,
+	                   edgeWeights() ) ) {
+		m_error = "repeated vertex id";
+		return false;
+	}
+	labels->reserve( labels->size() + n );
+	for(int i = 0; i < n; ++i)
+		labels->append( label(i) );
+	return true;
+}
+
+/* Pads the file to the next multiple of 8 bytes */
+static bool writeAligned( QFile *file, const void *data, quint64 size )
+{
+	static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	if( size && file->write( (const char*)data, size ) != (qint64)size )
+		return false;
+	quint64 padding = align( size ) - size;
+	return !padding || file->write( zeros, padding ) == (qint64)padding;
+}
+
+bool BinaryGraph::write( const QString &fileName, const GraphCore &core,
+                         const QVector<QString> &labels, QString *error )
+{
+	Q_ASSERT( labels.size() == core.size() );
+	int n = core.size();
+	int entries = 2 * core.edgeCount();
+
+	//the arrays in the types of the file
+	QVector<quint32> ids( n );
+	QVector<double> x( n ), y( n );
+	QVector<quint64> labelOffsets( n + 1 );
+	QByteArray labelBytes;
+	labelOffsets[0] = 0;
+	for(int i = 0; i < n; ++i) {
+		ids[i] = core.id(i);
+		x[i] = core.x(i);
+		y[i] = core.y(i);
+		labelBytes.append( labels.at(i).toUtf8() );
+		labelOffsets[i+1] = labelBytes.size();
+	}
+	QVector<quint64> rows( n + 1 );
+	QVector<quint32> neighbours( entries );
+	QVector<double> weights( entries );
+	const int *coreRows = core.offsets();
+	const int *coreNeighbours = core.neighbours();
+	const qreal *coreWeights = core.weights();
+	for(int i = 0; i <= n; ++i)
+		rows[i] = coreRows[i];
+	for(int k = 0; k < entries; ++k) {
+		neighbours[k] = coreNeighbours[k];
+		weights[k] = coreWeights[k];
+	}
+	int m = core.edgeCount();
+	QVector<quint32> heads( m ), tails( m );
+	QVector<double> edgeWeights( m );
+	for(int e = 0; e < m; ++e) {
+		heads[e] = core.head(e);
+		tails[e] = core.tail(e);
+		edgeWeights[e] = core.weight(e);
+	}
+
+	Header h;
+	memset( &h, 0, sizeof(h) );
+	memcpy( h.magic, MAGIC, sizeof(MAGIC) );
+	h.version = VERSION;
+	h.byteOrder = BYTEORDER;
+	h.vertexCount = n;
+	h.edgeCount = core.edgeCount();
+	h.ids = sizeof(Header);
+	h.x = align( h.ids + 4 * (quint64)n );
+	h.y = h.x + 8 * (quint64)n;
+	h.labelOffsets = h.y + 8 * (quint64)n;
+	h.labels = h.labelOffsets + 8 * (quint64)( n + 1 );
+	h.rows = align( h.labels + labelBytes.size() );
+	h.neighbours = h.rows + 8 * (quint64)( n + 1 );
+	h.weights = align( h.neighbours + 4 * (quint64)entries );
+	h.heads = h.weights + 8 * (quint64)entries;
+	h.tails = align( h.heads + 4 * (quint64)m );
+	h.edgeWeights = align( h.tails + 4 * (quint64)m );
+	h.fileSize = h.edgeWeights + 8 * (quint64)m;
+
+	QFile file( fileName );
+	bool ok = file.open( QIODevice::WriteOnly | QIODevice::Truncate )
+	          && writeAligned( &file, &h, sizeof(h) )
+	          && writeAligned( &file, ids.constData(), 4 * (quint64)n )
+	          && writeAligned( &file, x.constData(), 8 * (quint64)n )
+	          && writeAligned( &file, y.constData(), 8 * (quint64)n )
+	          && writeAligned( &file, labelOffsets.constData(),
+	                           8 * (quint64)( n + 1 ) )
+	          && writeAligned( &file, labelBytes.constData(), labelBytes.size() )
+	          && writeAligned( &file, rows.constData(), 8 * (quint64)( n + 1 ) )
+	          && writeAligned( &file, neighbours.constData(),
+	                           4 * (quint64)entries )
+	          && writeAligned( &file, weights.constData(), 8 * (quint64)entries )
+	          && writeAligned( &file, heads.constData(), 4 * (quint64)m )
+	          && writeAligned( &file, tails.constData(), 4 * (quint64)m )
+	          && writeAligned( &file, edgeWeights.constData(), 8 * (quint64)m );
+	if( !ok && error )
+		*error = fileName + ": " + file.errorString();
+	return ok;
+}
+
+bool BinaryGraph::isBinaryGraph( const QString &fileName )
+{
+	QFile file( fileName );
+	char magic[sizeof(MAGIC)];
+	return file.open( QIODevice::ReadOnly )
+	       && file.read( magic, sizeof(magic) ) == sizeof(magic)
+	       && memcmp( magic, MAGIC, sizeof(MAGIC) ) == 0;
+}
@@ -0,0 +1,118 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef BINARYGRAPH_H
+#define BINARYGRAPH_H
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class GraphCore;
+class QFile;
+
+/**
+ * @brief A graph file that is used straight from memory
+ *
+ * The file is a header followed by arrays, each starting at a multiple of
+ * 8 bytes, in the byte order of the machine that wrote it:
+ *
+ * - the vertex ids, n quint32
+ * - the x and the y coordinates, n doubles each
+ * - n + 1 quint64 offsets of the labels into the label bytes, then the
+ *   UTF-8 label bytes
+ * - the adjacency as compressed sparse rows: n + 1 quint64 row offsets,
+ *   then a quint32 neighbour index and a double weight for both ends of
+ *   every edge
+ * - the edges in the order of the core: m quint32 heads, m quint32 tails
+ *   and m double weights
+ *
+ * open() maps the file and checks the header, so the arrays are read in
+ * place without parsing anything. Their contents are trusted, only load()
+ * checks that the label offsets never decrease and the ends of the edges
+ * are in range. A file from a machine of the other byte order is
+ * refused, and so is one of version 1, which had no edge list.
+ */
+class BinaryGraph
+{
+public:
+	/// the version written into new files
+	static const quint32 VERSION = 2;
+
+	BinaryGraph();
+	/** unmaps the file */
+	~BinaryGraph();
+
+	/**
+	 * Maps the file @p fileName
+	 * @return false if it can't be mapped or isn't a graph file of a
+	 * version this can read, see errorString()
+	 */
+	bool open( const QString &fileName );
+	void close();
+	bool isOpen() const;
+	/** @return why the last open() or write() failed */
+	QString errorString() const;
+
+	/** @return the number of vertices */
+	int size() const;
+	/** @return the number of edges, each counted once */
+	int edgeCount() const;
+
+	const quint32* ids() const;
+	const double* xs() const;
+	const double* ys() const;
+	QString label( int i ) const;
+
+	/** @return size() + 1 offsets into neighbours() and weights() */
+	const quint64* offsets() const;
+	/** @return the neighbour at each end of every edge at every vertex */
+	const quint32* neighbours() const;
+	/** @return the weights parallel to neighbours() */
+	const double* weights() const;
+
+	/** @return the head of every edge, edgeCount() of them */
+	const quint32* heads() const;
+	/** @return the tail of every edge */
+	const quint32* tails() const;
+	/** @return the weight of every edge */
+	const double* edgeWeights() const;
+
+	/**
+	 * Copies the vertices and edges into the empty @p core with
+	 * GraphCore::assign() and the labels to @p labels, in O(n + m) without
+	 * sorting or looking anything up. The core is the one that was
+	 * written, down to the order and the ends of its edges.
+	 * @return false if the label offsets decrease, an end of an edge is
+	 * out of range or an id repeats
+	 */
+	bool load( GraphCore *core, QVector<QString> *labels );
+
+	/**
+	 * Writes @p core with the vertex labels @p labels to @p fileName
+	 * @param error where to put the reason if it fails, may be 0
+	 */
+	static bool write( const QString &fileName, const GraphCore &core,
+	                   const QVector<QString> &labels, QString *error = 0 );
+
+	/** @return true if @p fileName starts like a graph file */
+	static bool isBinaryGraph( const QString &fileName );
+
+private:
+	struct Header;
+
+	template<class T> const T* section( quint64 offset ) const;
+
+	QFile *m_file;
+	uchar *m_data;
+	const Header *m_header;
+	QString m_error;
+
+	Q_DISABLE_COPY( BinaryGraph )
+};
+
+#endif //include guard
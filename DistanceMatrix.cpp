@@ -0,0 +1,283 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "DistanceMatrix.h"
+
+// C++ std lib for the Dijkstra heap
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <climits>
+
+// QtCore
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+// graphs with more vertices than this get Packed storage by default
+static const int FULLSTORAGELIMIT = 4096;
+
+/* Breadth first search from s, for graphs where every edge has length 1 */
+static void bfs( const DistanceMatrix::Adjacency &adjacency, int s,
+                 QVector<qreal> &dist )
+{
+	QVector<int> queue;
+	queue.reserve( adjacency.size() );
+	dist[s] = 0.0;
+	queue.append( s );
+	for(int head = 0; head < queue.size(); ++head) {
+		int v = queue.at(head);
+		const QVector< QPair<int,qreal> > &adj = adjacency.at(v);
+		for(int j = 0; j < adj.size(); ++j) {
+			int u = adj.at(j).first;
+			if( dist.at(u) < 0.0 ) {
+				dist[u] = dist.at(v) + 1.0;
+				queue.append( u );
+			}
+		}
+	}
+}
+
+static void dijkstra( const DistanceMatrix::Adjacency &adjacency, int s,
+                      QVector<qreal> &dist )
+{
+	typedef std::pair<qreal,int> Entry;
+	std::priority_queue< Entry, std::vector<Entry>,
+	                     std::greater<Entry> > heap;
+	dist[s] = 0.0;
+	heap.push( Entry( 0.0, s ) );
+	while( !heap.empty() ) {
+		Entry top = heap.top();
+		heap.pop();
+		int v = top.second;
+		//stale entry, v was reached on a shorter path already
+		if( top.first > dist.at(v) )
+			continue;
+		const QVector< QPair<int,qreal> > &adj = adjacency.at(v);
+		for(int j = 0; j < adj.size(); ++j) {
+			int u = adj.at(j).first;
+			qreal d = top.first + adj.at(j).second;
+			if( dist.at(u) < 0.0 || d < dist.at(u) ) {
+				dist[u] = d;
+				heap.push( Entry( d, u ) );
+			}
+		}
+	}
+}
+
+/* A negative edge is a negative cycle both ways, and the searches use -1
+ * to mark the vertices they haven't reached */
+static bool isPositive( const DistanceMatrix::Adjacency &adjacency )
+{
+	for(int i = 0; i < adjacency.size(); ++i)
+		for(int j = 0; j < adjacency.at(i).size(); ++j)
+			if( !( adjacency.at(i).at(j).second > 0.0 ) )
+				return false;
+	return true;
+}
+
+static bool isWeighted( const DistanceMatrix::Adjacency &adjacency )
+{
+	for(int i = 0; i < adjacency.size(); ++i)
+		for(int j = 0; j < adjacency.at(i).size(); ++j)
+			if( adjacency.at(i).at(j).second != 1.0 )
+				return true;
+	return false;
+}
+
+/* Runs the single source searches for the sources first, first + stride,
+ * ... and writes them into the matrix. Every source owns its own row (or
+ * its part of the upper triangle) so no locking is needed. */
+class ShortestPaths : public QRunnable
+{
+public:
+	ShortestPaths( const DistanceMatrix::Adjacency &adjacency,
+	               DistanceMatrix *matrix, bool weighted,
+	               int first, int stride, qreal *diameter )
+	    : m_adjacency( adjacency ), m_matrix( matrix ),
+	      m_weighted( weighted ), m_first( first ), m_stride( stride ),
+	      m_diameter( diameter )
+	{
+	}
+
+	void run()
+	{
+		int n = m_adjacency.size();
+		QVector<qreal> dist( n );
+		qreal diameter = 0.0;
+		for(int s = m_first; s < n; s += m_stride) {
+			dist.fill( -1.0 );
+			if( m_weighted )
+				dijkstra( m_adjacency, s, dist );
+			else
+				bfs( m_adjacency, s, dist );
+			for(int j = 0; j < n; ++j)
+				diameter = qMax( diameter, dist.at(j) );
+			m_matrix->setRow( s, dist );
+		}
+		*m_diameter = diameter;
+	}
+
+private:
+	const DistanceMatrix::Adjacency &m_adjacency;
+	DistanceMatrix *m_matrix;
+	bool m_weighted;
+	int m_first;
+	int m_stride;
+	qreal *m_diameter;
+};
+
+DistanceMatrix::DistanceMatrix()
+{
+	m_storage = Full;
+	m_n = 0;
+	m_diameter = 0.0;
+	m_valid = false;
+}
+
+bool DistanceMatrix::compute( const Adjacency &adjacency, Storage storage,
+                              int threads )
+{
+	clear();
+	if( !isPositive( adjacency ) )
+		return false;
+	m_n = adjacency.size();
+	qint64 full = (qint64)m_n * m_n;
+	//a QVector holds at most INT_MAX values
+	if( storage == Automatic || ( storage == Full && full > INT_MAX ) )
+		storage = m_n > FULLSTORAGELIMIT ? Packed : Full;
+	m_storage = storage;
+	if( m_storage == Full ) {
+		m_full = QVector<qreal>( (int)full );
+	} else {
+		qint64 packed = packedIndex( m_n - 1, m_n - 1 ) + 1;
+		if( packed > INT_MAX ) {
+			clear();
+			return false;
+		}
+		m_packed = QVector<float>( (int)packed );
+	}
+
+	bool weighted = isWeighted( adjacency );
+
+	if( threads <= 0 )
+		threads = QThread::idealThreadCount();
+	threads = qMax( 1, qMin( threads, m_n ) );
+	QVector<qreal> diameters( threads, 0.0 );
+	QThreadPool pool;
+	pool.setMaxThreadCount( threads );
+	for(int t = 0; t < threads; ++t)
+		pool.start( new ShortestPaths( adjacency, this, weighted,
+		                               t, threads, &diameters[t] ) );
+	pool.waitForDone();
+
+	m_diameter = 0.0;
+	for(int t = 0; t < threads; ++t)
+		m_diameter = qMax( m_diameter, diameters.at(t) );
+
+	//the searches marked unreachable vertices with -1
+	qreal unreachable = m_diameter + 1.0;
+	if( m_storage == Full ) {
+		for(int i = 0; i < m_full.size(); ++i)
+			if( m_full.at(i) < 0.0 )
+				m_full[i] = unreachable;
+	} else {
+		for(int i = 0; i < m_packed.size(); ++i)
+			if( m_packed.at(i) < 0.0f )
+				m_packed[i] = unreachable;
+	}
+	m_valid = true;
+	return true;
+}
+
+QVector<qreal> DistanceMatrix::shortestPaths( const Adjacency &adjacency,
+                                              int source )
+{
+	QVector<qreal> dist( adjacency.size(), -1.0 );
+	if( isWeighted( adjacency ) )
+		dijkstra( adjacency, source, dist );
+	else
+		bfs( adjacency, source, dist );
+	return dist;
+}
+
+void DistanceMatrix::clear()
+{
+	m_full = QVector<qreal>();
+	m_packed = QVector<float>();
+	m_n = 0;
+	m_diameter = 0.0;
+	m_valid = false;
+}
+
+bool DistanceMatrix::isValid() const
+{
+	return m_valid;
+}
+
+int DistanceMatrix::size() const
+{
+	return m_n;
+}
+
+DistanceMatrix::Storage DistanceMatrix::storage() const
+{
+	return m_storage;
+}
+
+qreal DistanceMatrix::diameter() const
+{
+	return m_diameter;
+}
+
+/* Row i of the upper triangle starts after the rows 0..i-1, which have
+ * n, n-1, ..., n-i+1 entries */
+inline qint64 DistanceMatrix::packedIndex( int i, int j ) const
+{
+	if( i > j )
+		qSwap( i, j );
+	return (qint64)i * m_n - (qint64)i * ( i - 1 ) / 2 + ( j - i );
+}
+
+qreal DistanceMatrix::distance( int i, int j ) const
+{
+	if( m_storage == Full )
+		return m_full.at( (qint64)i * m_n + j );
+	return m_packed.at( packedIndex( i, j ) );
+}
+
+const qreal* DistanceMatrix::row( int i, qreal *scratch ) const
+{
+	if( m_storage == Full )
+		return m_full.constData() + (qint64)i * m_n;
+	const float *packed = m_packed.constData();
+	//column i above the diagonal, then the stored part of row i
+	for(int j = 0; j < i; ++j)
+		scratch[j] = packed[packedIndex( j, i )];
+	const float *r = packed + packedIndex( i, i );
+	for(int j = i; j < m_n; ++j)
+		scratch[j] = r[j - i];
+	return scratch;
+}
+
+void DistanceMatrix::setRow( int i, const QVector<qreal> &distances )
+{
+	if( m_storage == Full ) {
+		qreal *r = m_full.data() + (qint64)i * m_n;
+		for(int j = 0; j < m_n; ++j)
+			r[j] = distances.at(j);
+	} else {
+		float *r = m_packed.data() + packedIndex( i, i );
+		for(int j = i; j < m_n; ++j)
+			r[j - i] = distances.at(j);
+	}
+}
@@ -0,0 +1,104 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef DISTANCEMATRIX_H
+#define DISTANCEMATRIX_H
+
+#include <QtCore/QVector>
+#include <QtCore/QPair>
+
+/**
+ * @brief Graph-theoretic distances between all pairs of vertices
+ *
+ * Vertices are addressed by a dense index. The distances are computed with
+ * one breadth first search per vertex if every edge has weight 1, and with
+ * Dijkstra's algorithm using the edge weights as lengths otherwise. The
+ * searches run in parallel.
+ *
+ * Pairs in different connected components get the largest finite distance
+ * plus one, as suggested by Kamada and Kawai.
+ */
+class DistanceMatrix
+{
+public:
+	/// describes how the distances are stored
+	enum Storage {
+		Automatic, ///< Full for small graphs, Packed for large ones
+		Full,      ///< n² doubles, rows are returned without copying
+		Packed     ///< upper triangle of floats, about 1/4 of the memory
+	};
+
+	/** @typedef the neighbours and edge weights of every vertex */
+	typedef QVector< QVector< QPair<int,qreal> > > Adjacency;
+
+	DistanceMatrix();
+
+	/**
+	 * Computes all distances of the graph given by @p adjacency
+	 * @param adjacency for each vertex the (index, weight) of its
+	 * neighbours, every edge must appear for both of its ends.
+	 * Weights must be positive, GraphCore makes sure of that.
+	 * @param storage how to store the result. Full falls back to Packed
+	 * past 46340 vertices, where n² doubles no longer fit in a QVector;
+	 * Packed holds up to 65535 vertices.
+	 * @param threads the number of searches to run at once, 0 for one per
+	 * core
+	 * @return false if a weight isn't positive, which would make shortest
+	 * paths of length 0 or none at all, or if there are more than 65535
+	 * vertices; the matrix is invalid then
+	 */
+	bool compute( const Adjacency &adjacency, Storage storage = Automatic,
+	              int threads = 0 );
+
+	/**
+	 * Computes the distances from @p source only, for when the whole
+	 * matrix would be too large. The weights must be positive, as for
+	 * compute().
+	 * @return the distance of every vertex from @p source, -1 for the ones
+	 * that can't be reached
+	 */
+	static QVector<qreal> shortestPaths( const Adjacency &adjacency,
+	                                     int source );
+
+	/** throws away the distances, isValid() is false afterwards */
+	void clear();
+	/** @return true if the distances have been computed */
+	bool isValid() const;
+
+	/** @return the number of vertices */
+	int size() const;
+	/** @return the storage that is actually in use, never Automatic */
+	Storage storage() const;
+
+	/** @return the distance between vertices @p i and @p j */
+	qreal distance( int i, int j ) const;
+	/**
+	 * @return the distances from @p i to all vertices. With Full storage
+	 * this points into the matrix, otherwise the row is copied into
+	 * @p scratch, which must have room for size() values.
+	 */
+	const qreal* row( int i, qreal *scratch ) const;
+
+	/** @return the largest distance between connected vertices */
+	qreal diameter() const;
+
+private:
+	friend class ShortestPaths;
+
+	inline qint64 packedIndex( int i, int j ) const;
+	void setRow( int i, const QVector<qreal> &distances );
+
+	QVector<qreal> m_full;
+	QVector<float> m_packed;
+	Storage m_storage;
+	int m_n;
+	qreal m_diameter;
+	bool m_valid;
+};
+
+#endif //include guard
@@ -17,6 +17,7 @@
 
 #include "Vertex.h"
 #include "Graph.h"
+#include "ItemArena.h"
 
 static const QPen EDGEPEN( QBrush(QColor(Qt::black)), 2.0 );
 
@@ -26,14 +27,38 @@ Edge::Edge( Graph *g, Vertex *head, Vertex *tail, qreal weight,
 {
 	m_g = g;
 	m_head = head; m_tail = tail;
-	m_w = weight;
+	m_index = -1;
 
 	setLine( QLineF( m_head->nodePos(), m_tail->nodePos() ) );
 	setPen( EDGEPEN );
 	//this prevents edges being drawn over top of vertices
 	setZValue(0.9);
 	
-	m_g->edgeAdded(this);
+	m_g->edgeAdded(this, weight);
+}
+
+/* The graph unlinks the edge itself when it goes first */
+Edge::~Edge()
+{
+	if( m_index >= 0 )
+		m_g->edgeRemoved( this );
+}
+
+void* Edge::operator new( size_t size, Graph *g )
+{
+	return g->edgeArena()->allocate( size );
+}
+
+/* Only called if the constructor throws */
+void Edge::operator delete( void *p, Graph *g )
+{
+	Q_UNUSED( g );
+	ItemArena::release( p );
+}
+
+void Edge::operator delete( void *p )
+{
+	ItemArena::release( p );
 }
 
 Vertex* Edge::head() const
@@ -64,12 +89,23 @@ bool Edge::isTail( Vertex *v ) const
 
 qreal Edge::weight() const
 {
-	return m_w;
+	return m_g->core()->weight( m_index );
 }
 
 void Edge::setWeight( const qreal &weight )
 {
-	m_w = weight;
+	m_g->core()->setWeight( m_index, weight );
+	m_g->edgeChanged(this);
+}
+
+int Edge::index() const
+{
+	return m_index;
+}
+
+void Edge::setIndex( int index )
+{
+	m_index = index;
 }
 
 void Edge::updatePos()
@@ -14,11 +14,26 @@
 class Vertex;
 class Graph;
 
+/**
+ * The graphics item of an edge. The weight is kept in the GraphCore of the
+ * graph, this only draws the line.
+ */
 class Edge : public QGraphicsLineItem
 {
 public:
 	Edge(Graph *g, Vertex *head, Vertex *tail,
 	     qreal weight = 1.0, QGraphicsItem *parent = 0);
+	/** Takes the edge out of its graph */
+	~Edge();
+
+	/**
+	 * Edges live in the ItemArena of their graph, make them with
+	 * new( g ) Edge( g, ... ). They may be deleted like any other item,
+	 * by their scene or parent item too, while the graph exists.
+	 */
+	static void* operator new( size_t size, Graph *g );
+	static void operator delete( void *p, Graph *g );
+	static void operator delete( void *p );
 
 	Vertex* head() const;
 	bool isHead( Vertex* v ) const;
@@ -29,12 +44,17 @@ public:
 	qreal weight() const;
 	void setWeight(const qreal &w);
 
+	/** @return the index of the edge in the GraphCore of its graph */
+	int index() const;
+	/** used by the graph when the index changes */
+	void setIndex( int index );
+
 	void updatePos();
 private:
 	Graph *m_g;
 	Vertex *m_head;
 	Vertex *m_tail;
-	qreal m_w;
+	int m_index;
 };
 #endif //include guard
 
@@ -0,0 +1,133 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "EdgeLayer.h"
+
+// Qt
+#include <QtGui/QBrush>
+#include <QtGui/QColor>
+#include <QtGui/QPainter>
+#include <QtGui/QPen>
+#include <QtGui/QStyleOptionGraphicsItem>
+
+#include "Graph.h"
+#include "GraphCore.h"
+
+// the same pen as the Edge items
+static const QPen EDGEPEN( QBrush(QColor(Qt::black)), 2.0 );
+
+EdgeLayer::EdgeLayer( Graph *g, QGraphicsItem *parent )
+    : QGraphicsItem( parent )
+{
+	m_graph = g;
+	m_boundsDirty = false;
+	//without this the exposed rect is the whole bounding rect
+	setFlag( QGraphicsItem::ItemUsesExtendedStyleOption );
+	//this prevents edges being drawn over top of vertices
+	setZValue( 0.9 );
+	m_graph->setEdgeLayer( this );
+	positionsChanged();
+}
+
+EdgeLayer::~EdgeLayer()
+{
+	if( m_graph->edgeLayer() == this )
+		m_graph->setEdgeLayer( 0 );
+}
+
+/* Found again only when asked for, so a whole layout step or the building
+ * of a graph costs one sweep over the vertices instead of one per change */
+QRectF EdgeLayer::boundingRect() const
+{
+	if( !m_boundsDirty )
+		return m_bounds;
+	m_boundsDirty = false;
+	const GraphCore *core = m_graph->core();
+	m_bounds = QRectF();
+	if( core->size() > 0 ) {
+		qreal left = core->x(0), right = left;
+		qreal top = core->y(0), bottom = top;
+		for(int i = 1; i < core->size(); ++i) {
+			left = qMin( left, core->x(i) );
+			right = qMax( right, core->x(i) );
+			top = qMin( top, core->y(i) );
+			bottom = qMax( bottom, core->y(i) );
+		}
+		qreal half = EDGEPEN.widthF() / 2;
+		m_bounds = QRectF( left - half, top - half,
+		                   right - left + 2*half, bottom - top + 2*half );
+	}
+	return m_bounds;
+}
+
+void EdgeLayer::positionsChanged()
+{
+	m_index.clear();
+	//the scene is told once, until it has asked for the new bounds
+	if( m_boundsDirty )
+		return;
+	prepareGeometryChange();
+	m_boundsDirty = true;
+	update();
+}
+
+void EdgeLayer::paint( QPainter *painter,
+                       const QStyleOptionGraphicsItem *option,
+                       QWidget *widget )
+{
+	Q_UNUSED( widget );
+	const GraphCore *core = m_graph->core();
+	const qreal *x = core->xs().constData();
+	const qreal *y = core->ys().constData();
+
+	//the size of a pixel in item coordinates
+	qreal lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+	                painter->worldTransform() );
+	qreal pixel = lod > 0.0 ? 1.0 / lod : 0.0;
+	bool thin = EDGEPEN.widthF() < pixel;
+	qreal half = EDGEPEN.widthF() / 2;
+	QRectF exposed = option->exposedRect.adjusted( -half, -half, half, half );
+	qreal left = exposed.left(), right = exposed.right();
+	qreal top = exposed.top(), bottom = exposed.bottom();
+
+	//built on the first paint after a change, so scrolling reuses it
+	if( m_index.isEmpty() )
+		m_index.build( core );
+	m_edges.resize( 0 );
+	m_index.segments( exposed, &m_edges );
+
+	m_lines.resize( 0 );
+	m_lines.reserve( m_edges.size() );
+	for(int k = 0; k < m_edges.size(); ++k) {
+		int e = m_edges.at(k);
+		int a = core->head( e );
+		int b = core->tail( e );
+		qreal x1 = x[a], y1 = y[a], x2 = x[b], y2 = y[b];
+		if( qMax( x1, x2 ) < left || qMin( x1, x2 ) > right
+		    || qMax( y1, y2 ) < top || qMin( y1, y2 ) > bottom )
+			continue;
+		//an edge inside one pixel is hidden by its vertices anyway
+		if( thin && qAbs( x2 - x1 ) < pixel && qAbs( y2 - y1 ) < pixel )
+			continue;
+		m_lines.append( QLineF( x1, y1, x2, y2 ) );
+	}
+	if( m_lines.isEmpty() )
+		return;
+
+	painter->save();
+	if( thin ) {
+		QPen hairline( EDGEPEN );
+		hairline.setWidthF( 0.0 );
+		painter->setPen( hairline );
+		painter->setRenderHint( QPainter::Antialiasing, false );
+	} else
+		painter->setPen( EDGEPEN );
+	painter->drawLines( m_lines.constData(), m_lines.size() );
+	painter->restore();
+}
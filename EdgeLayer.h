@@ -0,0 +1,65 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef EDGELAYER_H
+#define EDGELAYER_H
+
+#include <QtCore/QLineF>
+#include <QtCore/QRectF>
+#include <QtCore/QVector>
+#include <QtGui/QGraphicsItem>
+
+#include "SegmentIndex.h"
+
+class Graph;
+
+/**
+ * @brief Draws all edges of a graph as one scene item
+ *
+ * A scene with an Edge item for every edge paints them one by one, each
+ * with its own pen and its own entry in the scene index. This draws the
+ * lines straight from the positions in Graph::core() in a single
+ * QPainter::drawLines() call. The edges near the exposed rect are found
+ * with a SegmentIndex, which is built again on the first paint after the
+ * vertices move, so a zoomed in view only touches the edges it shows.
+ * Put it in the scene instead of the Edge items; the graph tells it when
+ * the vertices move.
+ *
+ * When zoomed out, so an edge would be thinner than a pixel, the lines
+ * are drawn as hairlines without antialiasing, and edges shorter than a
+ * pixel are left out.
+ */
+class EdgeLayer : public QGraphicsItem
+{
+public:
+	/** Draws the edges of @p g, and becomes its edge layer */
+	EdgeLayer( Graph *g, QGraphicsItem *parent = 0 );
+	~EdgeLayer();
+
+	QRectF boundingRect() const;
+	void paint( QPainter *painter, const QStyleOptionGraphicsItem *option,
+	            QWidget *widget = 0 );
+
+	/**
+	 * Called by the graph after vertices have moved or the graph changed.
+	 * This only marks the bounds to be found again, so it is O(1).
+	 */
+	void positionsChanged();
+
+private:
+	Graph *m_graph;
+	mutable QRectF m_bounds;
+	mutable bool m_boundsDirty;
+	/// the edges by position, empty until the first paint after a change
+	SegmentIndex m_index;
+	/// the edges and lines of the last paint, kept to reuse the memory
+	QVector<int> m_edges;
+	QVector<QLineF> m_lines;
+};
+
+#endif //include guard
@@ -0,0 +1,136 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "EdgeTable.h"
+
+// the number of slots of an empty table
+static const int MINCAPACITY = 16;
+
+EdgeTable::EdgeTable()
+{
+	m_size = 0;
+	rehash( MINCAPACITY );
+}
+
+int EdgeTable::size() const
+{
+	return m_size;
+}
+
+void EdgeTable::clear()
+{
+	m_size = 0;
+	rehash( MINCAPACITY );
+}
+
+void EdgeTable::reserve( int pairs )
+{
+	int capacity = m_slots.size();
+	while( capacity < 2 * pairs )
+		capacity *= 2;
+	if( capacity > m_slots.size() )
+		rehash( capacity );
+}
+
+/* The splitmix64 finalizer, consecutive ids must not land next to each
+ * other or the runs of linear probing grow long */
+inline int EdgeTable::home( quint64 key ) const
+{
+	key ^= key >> 30;
+	key *= Q_UINT64_C( 0xbf58476d1ce4e5b9 );
+	key ^= key >> 27;
+	key *= Q_UINT64_C( 0x94d049bb133111eb );
+	key ^= key >> 31;
+	return (int)( key & ( m_slots.size() - 1 ) );
+}
+
+inline int EdgeTable::find( quint64 key ) const
+{
+	int mask = m_slots.size() - 1;
+	const Slot *table = m_slots.constData();
+	int s = home( key );
+	while( table[s].edge >= 0 && table[s].key != key )
+		s = ( s + 1 ) & mask;
+	return s;
+}
+
+void EdgeTable::rehash( int capacity )
+{
+	QVector<Slot> old = m_slots;
+	Slot empty;
+	empty.key = 0;
+	empty.weight = 0.0;
+	empty.edge = -1;
+	m_slots = QVector<Slot>( capacity, empty );
+	for(int s = 0; s < old.size(); ++s)
+		if( old.at(s).edge >= 0 )
+			m_slots[ find( old.at(s).key ) ] = old.at(s);
+}
+
+void EdgeTable::insert( uint a, uint b, int edge, qreal weight )
+{
+	//the table is grown once it would be fuller than 1/2
+	if( 2 * ( m_size + 1 ) > m_slots.size() )
+		rehash( 2 * m_slots.size() );
+	quint64 k = key( a, b );
+	Slot &slot = m_slots[ find( k ) ];
+	if( slot.edge < 0 )
+		++m_size;
+	slot.key = k;
+	slot.weight = weight;
+	slot.edge = edge;
+}
+
+/* Backward shift deletion: entries after the hole that could live in it
+ * are moved up, so no tombstones are needed */
+void EdgeTable::remove( uint a, uint b )
+{
+	int s = find( key( a, b ) );
+	if( m_slots.at(s).edge < 0 )
+		return;
+	int mask = m_slots.size() - 1;
+	int hole = s;
+	for(int next = ( s + 1 ) & mask; m_slots.at(next).edge >= 0;
+	    next = ( next + 1 ) & mask )
+	{
+		//an entry may fill the hole if its home is not in (hole, next]
+		int h = home( m_slots.at(next).key );
+		if( ( ( next - h ) & mask ) >= ( ( next - hole ) & mask ) ) {
+			m_slots[hole] = m_slots.at(next);
+			hole = next;
+		}
+	}
+	m_slots[hole].edge = -1;
+	--m_size;
+}
+
+int EdgeTable::edge( uint a, uint b ) const
+{
+	return m_slots.at( find( key( a, b ) ) ).edge;
+}
+
+qreal EdgeTable::weight( uint a, uint b, qreal missing ) const
+{
+	const Slot &slot = m_slots.at( find( key( a, b ) ) );
+	return slot.edge >= 0 ? slot.weight : missing;
+}
+
+void EdgeTable::setWeight( uint a, uint b, qreal weight )
+{
+	Slot &slot = m_slots[ find( key( a, b ) ) ];
+	if( slot.edge >= 0 )
+		slot.weight = weight;
+}
+
+void EdgeTable::setEdge( uint a, uint b, int edge )
+{
+	Slot &slot = m_slots[ find( key( a, b ) ) ];
+	if( slot.edge >= 0 )
+		slot.edge = edge;
+}
@@ -0,0 +1,75 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef EDGETABLE_H
+#define EDGETABLE_H
+
+#include <QtCore/QVector>
+
+/**
+ * @brief Hash table from an undirected vertex pair to its edge
+ *
+ * The key of the pair a, b is min(a,b) in the high and max(a,b) in the low
+ * 32 bits, so both directions find the same single entry. The table uses
+ * open addressing with linear probing and is kept at most half full, so a
+ * lookup is usually a single probe into one contiguous array. The weight
+ * is stored next to the key and comes back from the same probe.
+ */
+class EdgeTable
+{
+public:
+	EdgeTable();
+
+	/** @return the key of the undirected pair of vertex ids @p a, @p b */
+	static inline quint64 key( uint a, uint b )
+	{
+		return a < b ? ( (quint64)a << 32 ) | b : ( (quint64)b << 32 ) | a;
+	}
+
+	/** @return the number of pairs in the table */
+	int size() const;
+	/** removes all pairs */
+	void clear();
+	/** Makes room for @p pairs pairs without growing on the way */
+	void reserve( int pairs );
+
+	/** Adds the pair @p a, @p b or replaces what it maps to */
+	void insert( uint a, uint b, int edge, qreal weight );
+	/** Removes the pair @p a, @p b if it is in the table */
+	void remove( uint a, uint b );
+
+	/** @return the edge of the pair @p a, @p b, -1 if there is none */
+	int edge( uint a, uint b ) const;
+	/**
+	 * @return the weight of the edge between @p a and @p b, or @p missing
+	 * if they are not adjacent
+	 */
+	qreal weight( uint a, uint b, qreal missing = 0.0 ) const;
+
+	/** Changes the weight of an existing pair */
+	void setWeight( uint a, uint b, qreal weight );
+	/** Changes the edge of an existing pair */
+	void setEdge( uint a, uint b, int edge );
+
+private:
+	struct Slot {
+		quint64 key;
+		qreal weight;
+		int edge; ///< -1 for an empty slot
+	};
+
+	/** @return the slot holding @p key, or the empty slot ending its run */
+	inline int find( quint64 key ) const;
+	inline int home( quint64 key ) const;
+	void rehash( int capacity );
+
+	QVector<Slot> m_slots;
+	int m_size;
+};
+
+#endif //include guard
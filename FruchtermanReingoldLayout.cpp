@@ -0,0 +1,196 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "FruchtermanReingoldLayout.h"
+
+//math
+#include <cmath>
+
+#include "Graph.h"
+#include "WorkerPool.h"
+
+// the side of a cell of the spatial hash, repulsion is cut off beyond it
+static const qreal CELLSIZE = 2.0 * EDGELENGTH;
+// vertices closer than this are pushed apart as if they were this far
+static const qreal MINDISTANCE = 0.01;
+
+FruchtermanReingoldLayout::FruchtermanReingoldLayout( Graph *g,
+                                                      WorkerPool *pool )
+{
+	m_graph = g;
+	m_offsets = m_neighbours = 0;
+	m_x = g->core()->xs();
+	m_y = g->core()->ys();
+	int n = m_x.size();
+	m_dx = QVector<qreal>( n, 0.0 );
+	m_dy = QVector<qreal>( n, 0.0 );
+
+	//at least two buckets per vertex keeps the chains short
+	uint buckets = 1;
+	while( buckets < 2u * n )
+		buckets *= 2;
+	m_mask = buckets - 1;
+	m_head = QVector<int>( buckets, -1 );
+	m_next = QVector<int>( n, -1 );
+
+	m_ownPool = pool ? 0 : new WorkerPool( 1 );
+	m_pool = pool ? pool : m_ownPool;
+	m_moved = QVector<qreal>( m_pool->threadCount(), 0.0 );
+
+	//Fruchterman and Reingold start at a tenth of the width of the frame,
+	//which for n vertices about k apart is k sqrt(n)
+	m_temperature = EDGELENGTH * sqrt( (qreal)n ) / 10.0;
+	m_cooling = 0.95;
+}
+
+FruchtermanReingoldLayout::~FruchtermanReingoldLayout()
+{
+	delete m_ownPool;
+}
+
+int FruchtermanReingoldLayout::size() const
+{
+	return m_x.size();
+}
+
+qreal FruchtermanReingoldLayout::temperature() const
+{
+	return m_temperature;
+}
+
+void FruchtermanReingoldLayout::setTemperature( qreal temperature )
+{
+	m_temperature = qMax( (qreal)0.0, temperature );
+}
+
+qreal FruchtermanReingoldLayout::cooling() const
+{
+	return m_cooling;
+}
+
+void FruchtermanReingoldLayout::setCooling( qreal cooling )
+{
+	m_cooling = qBound( (qreal)0.0, cooling, (qreal)1.0 );
+}
+
+inline int FruchtermanReingoldLayout::bucket( int cx, int cy ) const
+{
+	return ( (uint)cx * 73856093u ^ (uint)cy * 19349663u ) & m_mask;
+}
+
+void FruchtermanReingoldLayout::hash()
+{
+	m_head.fill( -1 );
+	for(int i = 0; i < m_x.size(); ++i) {
+		int b = bucket( (int)floor( m_x.at(i) / CELLSIZE ),
+		                (int)floor( m_y.at(i) / CELLSIZE ) );
+		m_next[i] = m_head.at(b);
+		m_head[b] = i;
+	}
+}
+
+void FruchtermanReingoldLayout::forcesPart( int part, int begin, int end )
+{
+	const qreal k2 = EDGELENGTH * EDGELENGTH;
+	const qreal *x = m_x.constData();
+	const qreal *y = m_y.constData();
+	qreal moved = 0.0;
+	for(int i = begin; i < end; ++i) {
+		qreal fx = 0.0, fy = 0.0;
+
+		//repulsion from everybody within CELLSIZE, which are all in the
+		//3x3 cells around i. Two of those cells can share a bucket, which
+		//must not be walked twice.
+		int cx = (int)floor( x[i] / CELLSIZE );
+		int cy = (int)floor( y[i] / CELLSIZE );
+		int seen[9];
+		int buckets = 0;
+		for(int ox = -1; ox <= 1; ++ox) {
+			for(int oy = -1; oy <= 1; ++oy) {
+				int b = bucket( cx + ox, cy + oy );
+				bool walked = false;
+				for(int s = 0; s < buckets && !walked; ++s)
+					walked = seen[s] == b;
+				if( walked )
+					continue;
+				seen[buckets++] = b;
+				for(int j = m_head.at(b); j >= 0; j = m_next.at(j)) {
+					if( j == i )
+						continue;
+					qreal dx = x[i] - x[j];
+					qreal dy = y[i] - y[j];
+					qreal d2 = dx*dx + dy*dy;
+					if( d2 >= CELLSIZE * CELLSIZE )
+						continue;
+					if( d2 < MINDISTANCE * MINDISTANCE ) {
+						//coincident vertices, split them by their order
+						dx = i < j ? -MINDISTANCE : MINDISTANCE;
+						dy = 0.0;
+						d2 = MINDISTANCE * MINDISTANCE;
+					}
+					//k² / d along the unit vector is k² d / d²
+					fx += k2 * dx / d2;
+					fy += k2 * dy / d2;
+				}
+			}
+		}
+
+		//attraction to the neighbours, d² / k along the unit vector
+		for(int a = m_offsets[i]; a < m_offsets[i+1]; ++a) {
+			int j = m_neighbours[a];
+			qreal dx = x[i] - x[j];
+			qreal dy = y[i] - y[j];
+			qreal d = sqrt( dx*dx + dy*dy );
+			fx -= d * dx / EDGELENGTH;
+			fy -= d * dy / EDGELENGTH;
+		}
+
+		//move along the force, by no more than the temperature
+		qreal f = sqrt( fx*fx + fy*fy );
+		qreal step = qMin( f, m_temperature );
+		if( f > 0.0 ) {
+			m_dx[i] = fx / f * step;
+			m_dy[i] = fy / f * step;
+		} else {
+			m_dx[i] = m_dy[i] = 0.0;
+		}
+		moved = qMax( moved, step );
+	}
+	m_moved[part] = moved;
+}
+
+qreal FruchtermanReingoldLayout::iterate()
+{
+	int n = m_x.size();
+	if( n == 0 )
+		return 0.0;
+	hash();
+	//the rows are built on first use, which must not happen in a thread
+	m_offsets = m_graph->core()->offsets();
+	m_neighbours = m_graph->core()->neighbours();
+	ParallelMemberTask<FruchtermanReingoldLayout> task( this,
+	                               &FruchtermanReingoldLayout::forcesPart );
+	m_pool->run( &task, n );
+
+	for(int i = 0; i < n; ++i) {
+		m_x[i] += m_dx.at(i);
+		m_y[i] += m_dy.at(i);
+	}
+	qreal moved = 0.0;
+	for(int p = 0; p < m_pool->parts( n ); ++p)
+		moved = qMax( moved, m_moved.at(p) );
+	m_temperature *= m_cooling;
+	return moved;
+}
+
+void FruchtermanReingoldLayout::apply()
+{
+	m_graph->core()->setPositions( m_x, m_y );
+	m_graph->updateItems();
+}
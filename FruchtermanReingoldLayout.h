@@ -0,0 +1,95 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef FRUCHTERMANREINGOLDLAYOUT_H
+#define FRUCHTERMANREINGOLDLAYOUT_H
+
+#include <QtCore/QVector>
+
+class Graph;
+class WorkerPool;
+
+/**
+ * @brief State of a Fruchterman-Reingold layout in progress
+ *
+ * Neighbours attract each other with d² / k and all vertices repel each
+ * other with k² / d, where k is the desirable length of an edge. As in the
+ * grid variant of Fruchterman and Reingold, the repulsion is cut off at
+ * 2k: the vertices are hashed into square cells of side 2k at the start of
+ * every iteration, and a vertex only looks at the 3x3 cells around its
+ * own. An iteration is then O(n + m) for any reasonably spread out layout.
+ *
+ * Every vertex moves by its displacement capped at the temperature, which
+ * cools down geometrically from iteration to iteration. The forces are
+ * computed from the positions at the start of the iteration, so they are
+ * split over the threads of a WorkerPool without changing the result.
+ *
+ * Without long range repulsion a tangled start tends to stay crumpled, so
+ * this works best for tidying up a layout that is roughly right already.
+ */
+class FruchtermanReingoldLayout
+{
+public:
+	/**
+	 * Takes a snapshot of the positions of the vertices
+	 * @param g the graph to lay out
+	 * @param pool the threads to use, 0 for just the calling one
+	 */
+	FruchtermanReingoldLayout( Graph *g, WorkerPool *pool = 0 );
+	~FruchtermanReingoldLayout();
+
+	/** @return the number of vertices in the snapshot */
+	int size() const;
+
+	/** @return the largest distance a vertex may move in one iteration */
+	qreal temperature() const;
+	/** Sets the temperature, by default a tenth of the expected width */
+	void setTemperature( qreal temperature );
+	/** @return the factor the temperature is multiplied with each iteration */
+	qreal cooling() const;
+	/** Sets the cooling factor, 0.95 by default */
+	void setCooling( qreal cooling );
+
+	/**
+	 * Moves all vertices once and cools down
+	 * @return the largest distance a vertex moved
+	 */
+	qreal iterate();
+
+	/** Writes the positions back to the vertices */
+	void apply();
+
+private:
+	void hash();
+	/** @return the bucket of the cell in column @p cx and row @p cy */
+	inline int bucket( int cx, int cy ) const;
+	void forcesPart( int part, int begin, int end );
+
+	Graph *m_graph;
+	const int *m_offsets; ///< the neighbour rows of the graph's GraphCore
+	const int *m_neighbours;
+	QVector<qreal> m_x;
+	QVector<qreal> m_y;
+	QVector<qreal> m_dx;
+	QVector<qreal> m_dy;
+
+	/// the spatial hash: the first vertex of each bucket, then a list
+	QVector<int> m_head;
+	QVector<int> m_next;
+	uint m_mask;
+
+	QVector<qreal> m_moved; ///< the largest move of each part
+	qreal m_temperature;
+	qreal m_cooling;
+	WorkerPool *m_pool;
+	WorkerPool *m_ownPool;
+
+	Q_DISABLE_COPY( FruchtermanReingoldLayout )
+};
+
+#endif //include guard
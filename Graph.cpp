@@ -11,6 +11,7 @@
 
 //math
 #include <cmath>
+#include <climits>
 
 #ifdef Q_CC_MSVC
 #define M_PI 3.14159
@@ -21,449 +22,737 @@
 #include <QtGui/QGraphicsItem>
 
 // QtCore
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QList>
 #include <QtCore/QMap>
 #include <QtCore/QPair>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 #include <QtCore/QTextStream>
 #include <QtCore/QDebug>
 
 #include "Vertex.h"
 #include "Edge.h"
+#include "EdgeLayer.h"
+#include "BinaryGraph.h"
+#include "FruchtermanReingoldLayout.h"
+#include "GraphReader.h"
+#include "GraphViewport.h"
+#include "KamadaKawaiLayout.h"
+#include "LabelMetrics.h"
+#include "LayoutTelemetry.h"
+#include "MultilevelLayout.h"
+#include "StressLayout.h"
+#include "WorkerPool.h"
+
+// moving fewer items than this is cheaper than rebuilding the scene index
+static const int SUSPENDLIMIT = 64;
 
-#define force -0.1
-/* // not sure if these will be needed
-//like sine, but faster
-inline qreal fsin(qreal x)
+Graph::Graph()
 {
-	return x−pow(x,3)/6+pow(x,5)/120−pow(x,7)/5040+pow(x,9)/362880−pow(x,11)/39916800;
+	m_distanceStorage = DistanceMatrix::Automatic;
+	m_layoutThreads = 0;
+	m_repulsionTheta = 0.7;
+	m_telemetry = 0;
+	m_transactions = 0;
+	m_nextId = 1;
+	m_edgeLayer = 0;
+	m_viewport = 0;
+	m_headless = false;
 }
 
-//like cosine, but faster
-inline qreal fcos(qreal x)
+Graph::Graph( const GraphCore &core, const QVector<QString> &labels )
+    : m_core( core ), m_labels( labels )
 {
-	return 1-pow(x,2)/2+pow(x,4)/24-pow(x,6)/720+pow(x,8)/40328-pow(x,10)/3628800;
-} */
+	m_distanceStorage = DistanceMatrix::Automatic;
+	m_layoutThreads = 0;
+	m_repulsionTheta = 0.7;
+	m_telemetry = 0;
+	m_transactions = 0;
+	m_nextId = 1;
+	m_edgeLayer = 0;
+	m_viewport = 0;
+	m_headless = true;
+}
 
-Graph::Graph()
+/* The items are unlinked first, so their destructors leave the core
+ * alone. The arenas go after this, once they are empty. */
+Graph::~Graph()
+{
+	for(int e = 0; e < m_edgeItems.size(); ++e)
+		m_edgeItems.at(e)->setIndex( -1 );
+	for(int i = 0; i < m_vertexItems.size(); ++i)
+		m_vertexItems.at(i)->setIndex( -1 );
+	for(int e = 0; e < m_edgeItems.size(); ++e)
+		delete m_edgeItems.at(e);
+	for(int i = 0; i < m_vertexItems.size(); ++i)
+		delete m_vertexItems.at(i);
+}
+
+ItemArena* Graph::vertexArena()
+{
+	return &m_vertexArena;
+}
+
+ItemArena* Graph::edgeArena()
+{
+	return &m_edgeArena;
+}
+
+GraphCore* Graph::core()
+{
+	return &m_core;
+}
+
+const GraphCore* Graph::core() const
 {
-	m_vertices = QMap<uint,Vertex*>();
-	m_edges = QMap<QPair<Vertex*,Vertex*>,Edge*>();
+	return &m_core;
+}
+
+Vertex* Graph::vertex( uint id ) const
+{
+	int i = m_core.index( id );
+	return i < 0 || isHeadless() ? 0 : m_vertexItems.at(i);
+}
+
+Edge* Graph::edge( uint a, uint b ) const
+{
+	int e = m_core.findEdge( a, b );
+	return e < 0 || isHeadless() ? 0 : m_edgeItems.at(e);
+}
+
+Vertex* Graph::vertexAt( int i ) const
+{
+	return isHeadless() ? 0 : m_vertexItems.at(i);
+}
+
+Edge* Graph::edgeAt( int e ) const
+{
+	return isHeadless() ? 0 : m_edgeItems.at(e);
+}
+
+bool Graph::isHeadless() const
+{
+	return m_headless;
+}
+
+const QVector<Vertex*>& Graph::vertexItems() const
+{
+	return m_vertexItems;
+}
+
+const QVector<Edge*>& Graph::edgeItems() const
+{
+	return m_edgeItems;
 }
 
 QMap<uint,Vertex*> Graph::vertices() const
 {
-	return m_vertices;
+	QMap<uint,Vertex*> vertices;
+	for(int i = 0; i < m_vertexItems.size(); ++i)
+		vertices.insert( m_core.id(i), m_vertexItems.at(i) );
+	return vertices;
 }
 
 QMap<QPair<Vertex*,Vertex*>,Edge*> Graph::edges() const
 {
-	return m_edges;
+	QMap<QPair<Vertex*,Vertex*>,Edge*> edges;
+	for(int e = 0; e < m_edgeItems.size(); ++e) {
+		Edge *edge = m_edgeItems.at(e);
+		edges.insert( qMakePair( edge->head(), edge->tail() ), edge );
+		edges.insert( qMakePair( edge->tail(), edge->head() ), edge );
+	}
+	return edges;
 }
 
-void Graph::vertexAdded( Vertex* v )
+void Graph::vertexAdded( Vertex* v, const QPointF &pos )
 {
-	m_vertices.insert( v->id(), v );
+	Q_ASSERT( !isHeadless() );
+	v->setIndex( m_core.addVertex( v->id(), pos.x(), pos.y() ) );
+	m_vertexItems.append( v );
+	m_distances.clear();
+	if( m_edgeLayer )
+		m_edgeLayer->positionsChanged();
 }
 
-void Graph::edgeAdded( Edge* e )
+void Graph::edgeAdded( Edge* e, qreal weight )
 {
-	m_edges.insert( qMakePair(e->head(), e->tail()), e );
-	m_edges.insert( qMakePair(e->tail(), e->head()), e );
-	e->head()->addEdge(e);
-	e->tail()->addEdge(e);
+	e->setIndex( m_core.addEdge( e->head()->index(), e->tail()->index(),
+	                             weight ) );
+	m_edgeItems.append( e );
+	m_distances.clear();
+	if( m_edgeLayer )
+		m_edgeLayer->positionsChanged();
 }
 
 void Graph::vertexRemoved( Vertex* v )
 {
-	if( m_vertices.contains( v->id() ) )
-		m_vertices.remove( v->id() );
-
-	/* Once a vertex is removed we must look through for any edges
-	 * that link to it and remove them too */
-	QMap<QPair<Vertex*,Vertex*>,Edge*>::iterator i = m_edges.begin();
-	for(QMap<QPair<Vertex*,Vertex*>,Edge*>::iterator i;
-	    i != m_edges.end(); ++i) {
-		if( (*i)->isHead(v) || (*i)->isTail(v) ) {
-			Edge *e = *i;
-			//if the edge is in a QGraphicsScene we must remove it
-			if( e->scene() ) {
-				e->scene()->removeItem( e );
-			}
-			// Remove the item at i and advance to the next item
-			i = m_edges.erase( i );
-			delete e;
-		} else {
-			++i; //advance to next item
-		}
+	/* Once a vertex is removed we must remove the edges that link to it
+	 * too. Removing one renumbers the last edge, so collect them first. */
+	QList<Edge*> edges = v->edges();
+	for(int j = 0; j < edges.size(); ++j) {
+		Edge *e = edges.at(j);
+		//if the edge is in a QGraphicsScene we must remove it
+		if( e->scene() )
+			e->scene()->removeItem( e );
+		edgeRemoved( e );
+		delete e;
 	}
+
+	int i = v->index();
+	int moved = m_core.removeVertex( i );
+	if( moved >= 0 ) {
+		m_vertexItems[i] = m_vertexItems.at( moved );
+		m_vertexItems[i]->setIndex( i );
+	}
+	m_vertexItems.remove( m_vertexItems.size() - 1 );
+	v->setIndex( -1 );
+	m_distances.clear();
+	if( m_edgeLayer )
+		m_edgeLayer->positionsChanged();
 }
 
 /* Isolated nodes are not autoremoved so this is fairly simple */
 void Graph::edgeRemoved( Edge* e )
 {
-	m_edges.remove( qMakePair(e->head(), e->tail()) );
-	m_edges.remove( qMakePair(e->tail(), e->head()) );
-	e->head()->removeEdge(e);
-	e->tail()->removeEdge(e);
+	int i = e->index();
+	int moved = m_core.removeEdge( i );
+	if( moved >= 0 ) {
+		m_edgeItems[i] = m_edgeItems.at( moved );
+		m_edgeItems[i]->setIndex( i );
+	}
+	m_edgeItems.remove( m_edgeItems.size() - 1 );
+	e->setIndex( -1 );
+	m_distances.clear();
+	if( m_edgeLayer )
+		m_edgeLayer->positionsChanged();
+}
+
+void Graph::updateItems()
+{
+	if( m_transactions > 0 )
+		return;
+	if( m_viewport )
+		m_viewport->positionsChanged();
+	if( m_headless ) {
+		//a headless graph may still have its edges drawn
+		if( m_edgeLayer )
+			m_edgeLayer->positionsChanged();
+		return;
+	}
+	QVector<bool> moved( m_vertexItems.size(), false );
+	int count = 0;
+	for(int i = 0; i < m_vertexItems.size(); ++i)
+		if( m_vertexItems.at(i)->isMoved() ) {
+			moved[i] = true;
+			++count;
+		}
+	if( count == 0 )
+		return;
+
+	/* Every item that moves is taken out of the BSP tree and put back in.
+	 * Past a few items one rebuild of the whole tree is cheaper. */
+	QGraphicsScene *scene = m_vertexItems.at(0)->scene();
+	bool suspend = scene && count >= SUSPENDLIMIT
+	               && count * 4 >= m_vertexItems.size()
+	               && scene->itemIndexMethod() == QGraphicsScene::BspTreeIndex;
+	if( suspend )
+		scene->setItemIndexMethod( QGraphicsScene::NoIndex );
+	for(int i = 0; i < m_vertexItems.size(); ++i)
+		if( moved.at(i) )
+			m_vertexItems.at(i)->updatePos();
+	//with a layer the edges are usually not in the scene at all
+	for(int e = 0; e < m_edgeItems.size(); ++e)
+		if( ( moved.at( m_core.head(e) ) || moved.at( m_core.tail(e) ) )
+		    && ( !m_edgeLayer || m_edgeItems.at(e)->scene() ) )
+			m_edgeItems.at(e)->updatePos();
+	if( suspend )
+		scene->setItemIndexMethod( QGraphicsScene::BspTreeIndex );
+	if( m_edgeLayer )
+		m_edgeLayer->positionsChanged();
+}
+
+void Graph::beginTransaction()
+{
+	++m_transactions;
+}
+
+void Graph::commit()
+{
+	Q_ASSERT( m_transactions > 0 );
+	if( --m_transactions == 0 )
+		updateItems();
+}
+
+bool Graph::isInTransaction() const
+{
+	return m_transactions > 0;
+}
+
+void Graph::setEdgeLayer( EdgeLayer *layer )
+{
+	m_edgeLayer = layer;
+}
+
+EdgeLayer* Graph::edgeLayer() const
+{
+	return m_edgeLayer;
+}
+
+void Graph::setViewport( GraphViewport *viewport )
+{
+	m_viewport = viewport;
+}
+
+GraphViewport* Graph::viewport() const
+{
+	return m_viewport;
+}
+
+/* A new weight changes the shortest paths */
+void Graph::edgeChanged( Edge* e )
+{
+	Q_UNUSED( e );
+	m_distances.clear();
+}
+
+const DistanceMatrix& Graph::distances()
+{
+	if( !m_distances.isValid() )
+		m_distances.compute( m_core.adjacency(), m_distanceStorage,
+		                     m_layoutThreads );
+	return m_distances;
+}
+
+void Graph::setDistanceStorage( DistanceMatrix::Storage storage )
+{
+	if( storage != m_distanceStorage )
+		m_distances.clear();
+	m_distanceStorage = storage;
+}
+
+DistanceMatrix::Storage Graph::distanceStorage() const
+{
+	return m_distanceStorage;
 }
 
 /* A valid id is one that isn't already used */
 bool Graph::isValidNewId(uint id) const
 {
-	return !m_vertices.contains( id );
+	return m_core.index( id ) < 0;
 }
 
-/*These snippets are defined here to make regexps more readable */
-static const QString qE = "([0-9]+\\.?[0-9]*)"; //captures qreals
-static const QString uE = "([0-9]+)"; //captures uints
+uint Graph::newId()
+{
+	while( m_nextId == 0 || !isValidNewId( m_nextId ) )
+		++m_nextId;
+	return m_nextId++;
+}
 
 Graph* Graph::readGraph( QTextStream *s, QGraphicsItem *parent )
 {
-	Graph *g = new Graph();
+	GraphReader reader;
+	reader.read( s );
+	return buildGraph( &reader, parent );
+}
+
+Graph* Graph::readGraph( const QString &fileName, QGraphicsItem *parent,
+                         int threads )
+{
+	GraphReader reader;
+	if( threads == 1 ) {
+		reader.readFile( fileName );
+	} else {
+		WorkerPool pool( threads );
+		reader.readFile( fileName, &pool );
+	}
+	return buildGraph( &reader, parent );
+}
 
-	//This regexp matches the definition of a vertex
-	QRegExp vdef("\\s*"+uE+"\\s+\\[label=\"(.*)\",pos=\""+qE+"\\s+"+qE+"\"\\]");
-	//This regexp matches the definition of an edge
-	QRegExp edef("\\s*"+uE+"\\s*--\\s*"+uE+"\\s*\\[weight=\""+qE+"\"\\]" );
-
-	while( !s->atEnd() ) {
-		QString curline = s->readLine();
-		if( curline.contains(vdef) ) { //Does this line define a vertex?
-			//qDebug() << vdef.pattern() << "  MATCHES  " << curline;
-
-			bool ok = false; //pessimists are never dissapointed
-			uint id = vdef.cap(1).toUInt(&ok);
-			if(!ok) {
-				qDebug() << "error: couldn't do toUInt(" << vdef.cap(1);
-				continue;
-			} else ok = false;
-
-			QString label = vdef.cap(2);
-
-			qreal x = vdef.cap(3).toDouble(&ok);
-			if(!ok) {
-				qDebug() << "error: couldn't do toDouble(" << vdef.cap(3);
-				continue;
-			} else ok = false;
-			qreal y = vdef.cap(4).toDouble(&ok);
-			if(!ok) {
-				qDebug() << "error: couldn't do toDouble(" << vdef.cap(4);
-				continue;
-			}
-
-			qDebug() << "New Vertex with label \"" << label << "\", id"
-			         << id << ", and X,Y " << x << "," << y;
-
-			Vertex *v = new Vertex(g,id,label,QPointF(x,y),parent);
-
-		} else if( curline.contains(edef) ) { //Does this line define an edge?
-			//qDebug() << edef.pattern() << "  MATCHES  " << curline;
-			bool ok = false; //pessimists are never dissapointed
-
-			uint head_id = edef.cap(1).toUInt(&ok);
-			if(!ok) {
-				qDebug() << "error: couldn't do toUInt(" << edef.cap(1);
-				continue;
-			} else ok = false;
-
-			uint tail_id = edef.cap(2).toUInt(&ok);
-			if(!ok) {
-				qDebug() << "error: couldn't do toUInt(" << edef.cap(2);
-				continue;
-			} else ok = false;
-
-			qreal w = edef.cap(3).toDouble(&ok);
-			if(!ok) {
-				qDebug() << "error: couldn't do toDouble(" << edef.cap(3);
-				continue;
-			}
-
-			qDebug()<<"New edge (w="<<w<<") between "<<head_id<<" "<<tail_id;
-			if( !g->vertices().contains(head_id) ) {
-				qDebug() << "error: id " << head_id << " not found";
-				continue;
-			} else if( !g->vertices().contains(tail_id) ) {
-				qDebug() << "error: id " << tail_id << " not found";
-				continue;
-			}
-
-			Edge *e = new Edge(g, g->vertices().value(head_id),
-			                      g->vertices().value(tail_id), w );
+Graph* Graph::readHeadlessGraph( const QString &fileName, int threads )
+{
+	if( BinaryGraph::isBinaryGraph( fileName ) ) {
+		BinaryGraph file;
+		GraphCore core;
+		QVector<QString> labels;
+		if( !file.open( fileName ) || !file.load( &core, &labels ) ) {
+			qWarning() << "error:" << file.errorString();
+			return 0;
 		}
+		return new Graph( core, labels );
 	}
-	return g;
+	GraphReader reader;
+	bool read;
+	if( threads == 1 ) {
+		read = reader.readFile( fileName );
+	} else {
+		WorkerPool pool( threads );
+		read = reader.readFile( fileName, &pool );
+	}
+	if( !read ) {
+		qWarning() << "error:" << reader.errors().join( "\n" );
+		return 0;
+	}
+	return buildGraph( &reader, 0, true );
 }
 
-void Graph::writeGraph( QTextStream *s, Graph *g )
+Graph* Graph::buildGraph( GraphReader *reader, QGraphicsItem *parent,
+                          bool headless )
 {
-	//get a copy to use a bunch of times
-	QMap<uint,Vertex*> vertices = g->vertices();
-	for(QMap<uint,Vertex*>::const_iterator i = vertices.constBegin();
-	    i != vertices.constEnd(); ++i )
-	{
-		//i.key is the id, which comes first
-		*s << '\t' << i.key() << " [";
-		//Replace " with \" to avoid confusion when loading
-		*s << "label=\"" << i.value()->text().replace("\"", "\\\"") << "\",";
-		QPointF p = i.value()->nodePos();
-		*s << "pos=\"" << p.x() << " " << p.y() << "\"];\n";
+	GraphCore core;
+	QVector<QString> labels;
+	reader->build( &core, &labels );
+	//only the errors are logged, not every statement
+	QStringList errors = reader->errors();
+	for(int i = 0; i < errors.size(); ++i)
+		qWarning() << "error:" << errors.at(i);
+	if( reader->errorCount() > errors.size() )
+		qWarning() << "error:" << reader->errorCount() - errors.size()
+		           << "more errors";
+	if( headless )
+		return new Graph( core, labels );
+	return fromCore( core, labels, parent );
+}
+
+Graph* Graph::readBinaryGraph( const QString &fileName, QGraphicsItem *parent )
+{
+	BinaryGraph file;
+	GraphCore core;
+	QVector<QString> labels;
+	if( !file.open( fileName ) || !file.load( &core, &labels ) ) {
+		qWarning() << "error:" << file.errorString();
+		return 0;
 	}
-	//add a seperator between node defs and edge defs
-	*s << "\n\n\n\n";
-	//get a copy to use a bunch of times
-	QMap<QPair<Vertex*, Vertex*>, Edge*> edges = g->edges();
-	for(QMap<QPair<Vertex*, Vertex*>, Edge*>::const_iterator i =
-	    edges.constBegin(); i != edges.constEnd(); ++i )
-	{
-		*s << '\t' << (*i)->head()->id() << " -- " << (*i)->tail()->id();
-		*s << " [weight=\"" << (*i)->weight() << "\"];\n";
+	return fromCore( core, labels, parent );
+}
+
+bool Graph::writeBinaryGraph( const QString &fileName, Graph *g )
+{
+	QString error;
+	if( !BinaryGraph::write( fileName, g->m_core, g->labels(), &error ) ) {
+		qWarning() << "error:" << error;
+		return false;
 	}
+	return true;
 }
 
-inline qreal Graph::kij( Vertex *i, Vertex *j )
+Graph* Graph::fromCore( const GraphCore &core, const QVector<QString> &labels,
+                        QGraphicsItem *parent )
 {
-    if(m_edges.contains(qMakePair(i,j)))
-        return m_edges.value(qMakePair(i,j))->weight() / pow( distanceVertex( i,j ), 2.0 );
-    else
-        return 0.0;
+	Graph *g = new Graph();
+	g->m_core.reserve( core.size(), core.edgeCount() );
+	g->m_vertexItems.reserve( core.size() );
+	g->m_edgeItems.reserve( core.edgeCount() );
+	//the items get the same indices and ids in g->core() as in core
+	for(int i = 0; i < core.size(); ++i)
+		new( g ) Vertex( g, core.id(i), labels.at(i),
+		                 QPointF( core.x(i), core.y(i) ), parent, true );
+	for(int e = 0; e < core.edgeCount(); ++e)
+		new( g ) Edge( g, g->vertexAt( core.head(e) ),
+		               g->vertexAt( core.tail(e) ), core.weight(e) );
+	return g;
 }
 
-inline qreal Graph::lij( Vertex *i, Vertex *j )
+QVector<QString> Graph::labels() const
 {
-	return 100.0;
+	if( isHeadless() )
+		return m_labels;
+	QVector<QString> labels( m_vertexItems.size() );
+	for(int i = 0; i < m_vertexItems.size(); ++i)
+		labels[i] = m_vertexItems.at(i)->text();
+	return labels;
 }
 
-inline qreal Graph::distanceVertex( Vertex *i, Vertex *j )
+QVector<QSizeF> Graph::labelSizes() const
 {
-    // sqrt( (i.x-j.x)^2 + (i.y - j.y)^2 )
-	return distancePoint( i->nodePos(), j->nodePos() );
+	return Vertex::labelMetrics()->sizes( labels() );
 }
 
-inline qreal Graph::distancePoint( const QPointF& i, const QPointF& j )
+void Graph::writeGraph( QTextStream *s, Graph *g )
 {
-    // sqrt( (i.x-j.x)^2 + (i.y - j.y)^2 )
-	return sqrt( pow( i.x() - j.x(), 2.0 ) + pow( i.y() - j.y(), 2.0 ) );
+	writeGraph( s, g->m_core, g->labels() );
 }
 
-//kk89 eq 7
-qreal Graph::del_E__del_xm(Vertex *m)
+void Graph::writeGraph( QTextStream *s, const GraphCore &core,
+                        const QVector<QString> &labels )
 {
-	qreal result = 0;
-	//qDebug() << "begin del_E__del_xm" << result;
-	QPointF mp = m->nodePos();
-	for(QMap<uint,Vertex*>::const_iterator i = m_vertices.constBegin();
-	    i != m_vertices.constEnd(); ++i )
-	{
-		if( *i == m )
-			continue;
-		QPointF ip = (*i)->nodePos();
-		qreal top = kij( m, *i ) * ( mp.x() - ip.x() );
-		qreal bot = distancePoint( mp, ip );
-        qreal gravity = -1* force * ( mp.x() - ip.x() ) / pow(distancePoint(mp, ip), 3.0);
-		//qDebug() << "\tkij( m,*i )" << kij( m,*i );
-		//qDebug() << "\t( mp.x() - ip.x() )" << ( mp.x() - ip.x() );
-		//qDebug() << "\ttop/bot" << top << bot <<top/bot;
-		result += kij( m,*i ) * ( ( mp.x() - ip.x() ) - top / bot ) - gravity;
-		//qDebug() << "del_E__del_xm" << result;
-	}
-	//qDebug() << "final del_E__del_xm" << result;
-	return result;
-}
-
-//kk89 eq 8
-qreal Graph::del_E__del_ym(Vertex *m)
-{
-	qreal result = 0;
-	//qDebug() << "begin del_E__del_ym" << result;
-	QPointF mp = m->nodePos();
-	for(QMap<uint,Vertex*>::const_iterator i = m_vertices.constBegin();
-	    i != m_vertices.constEnd(); ++i )
-	{
-		if( *i == m )
-			continue;
-		QPointF ip = (*i)->nodePos();
-		qreal top = kij( m, *i ) * ( mp.y() - ip.y() );
-		qreal bot = distancePoint( mp, ip );
-        qreal gravity = -1* force * ( mp.y() - ip.y() ) / pow(distancePoint(mp, ip), 3.0);
-		//qDebug() << "\tkij( m,*i )" << kij( m,*i );
-		//qDebug() << "\t( mp.y() - ip.y() )" << ( mp.y() - ip.y() );
-		//qDebug() << "\ttop/bot" << top << bot << top/bot;
-		result += kij( m,*i ) * ( ( mp.y() - ip.y() ) - top / bot) + gravity;
-		//qDebug() << "del_E__del_ym" << result;
-	}
-	//qDebug() << "final del_E__del_ym" << result;
-	return result;
-}
-
-//kk89 eq 13
-// second derivate after x_m
-qreal Graph::del2_E__del_x2m(Vertex *m)
-{
-	qreal result = 0;
-	//qDebug() << "begin del2_E__del_x2m" << result;
-	QPointF mp = m->nodePos();
-	for(QMap<uint,Vertex*>::const_iterator i = m_vertices.constBegin();
-	    i != m_vertices.constEnd(); ++i )
-	{
-		if( *i == m )
-			continue;
-		QPointF ip = (*i)->nodePos();
-		qreal top = kij( m, *i ) * pow( mp.y() - ip.y(), 2.0 );
-		qreal bot = pow( distancePoint( mp, ip ), 3.0 );
-        qreal gravity = 3*pow( mp.x() - ip.x(), 2.0 )/pow( distancePoint( mp, ip ), 5.0 ) - 1 / pow( distancePoint( mp, ip ), 3.0 );
-		result += kij( m,*i ) * (1.0 - top / bot) + gravity;
-		//qDebug() << "del2_E__del_x2m" << result;
+	for(int i = 0; i < core.size(); ++i) {
+		//the id comes first
+		*s << '\t' << core.id(i) << " [";
+		//Replace " with \" to avoid confusion when loading
+		QString label = labels.at(i);
+		*s << "label=\"" << label.replace("\"", "\\\"") << "\",";
+		*s << "pos=\"" << core.x(i) << " " << core.y(i) << "\"];\n";
 	}
-	//qDebug() << "final del2_E__del_x2m" << result;
-	return result;
-}
-
-//kk89 eq 14, eq 15
-// mixed second derivative
-qreal Graph::del2_E__delxm_delym(Vertex *m)
-{
-	qreal result = 0;
-	//qDebug() << "begin del2_E__delxm_delym" << result;
-	QPointF mp = m->nodePos();
-	for(QMap<uint,Vertex*>::const_iterator i = m_vertices.constBegin();
-	    i != m_vertices.constEnd(); ++i )
-	{
-		if( *i == m )
-			continue;
-		QPointF ip = (*i)->nodePos();
-		qreal top = kij( m, *i ) * (mp.y() - ip.y()) * (mp.x() - ip.x());
-		qreal bot = pow( distancePoint( mp, ip ), 3.0 );
-        qreal gravity = (3*(mp.y() - ip.y()) * (mp.x() - ip.x()))/pow( distancePoint( mp, ip ), 5.0 );
-		result += kij( m,*i ) * (top/bot) + gravity;
-		//qDebug() << "del2_E__delxm_delym" << result;
+	//add a seperator between node defs and edge defs
+	*s << "\n\n\n\n";
+	//each edge is stored once, so each edge is written once
+	for(int e = 0; e < core.edgeCount(); ++e) {
+		*s << '\t' << core.id( core.head(e) ) << " -- "
+		   << core.id( core.tail(e) );
+		*s << " [weight=\"" << core.weight(e) << "\"];\n";
 	}
-	//qDebug() << "final del2_E__delxm_delym" << result;
-	return result;
-}
-
-//kk89 eq 16
-// second derivate after y_m
-qreal Graph::del2_E__del_y2m(Vertex *m)
-{
-	qreal result = 0;
-	//qDebug() << "begin del2_E__del_y2m" << result;
-	QPointF mp = m->nodePos();
-	for(QMap<uint,Vertex*>::const_iterator i = m_vertices.constBegin();
-	    i != m_vertices.constEnd(); ++i )
-	{
-		if( *i == m )
-			continue;
-		QPointF ip = (*i)->nodePos();
-		qreal top = kij( m, *i ) * pow( mp.x() - ip.x(), 2.0 );
-		qreal bot = pow( distancePoint( mp, ip ), 3.0 );
-        qreal gravity = 3*pow( mp.y() - ip.y(), 2.0 ) / pow( distancePoint( mp, ip ), 5.0 ) - 1 / pow( distancePoint( mp, ip ), 3.0 );
-		result += kij( m,*i ) * (1.0 - top/bot) + gravity;
-		//qDebug() << "del2_E__del_y2m" << result;
+}
+
+void Graph::layoutNGon()
+{
+	int n = m_core.size();
+	qreal inc = (2.0 * M_PI)/n;
+	qreal angle = 0.1;
+	for(int i = 0; i < n; ++i) {
+		m_core.setPosition( i, 100.0*cos(angle), 100.0*sin(angle) );
+		angle += inc;
 	}
-	//qDebug() << "final del2_E__del_y2m" << result;
-	return result;
+	updateItems();
 }
 
-//from kk89 eq 11, eq 12
-qreal Graph::dx(Vertex *m)
+
+void Graph::setLayoutThreads( int threads )
 {
-	qreal top = ( ( del2_E__delxm_delym(m) * del_E__del_ym(m) ) / del2_E__del_y2m(m) )
-	            - del_E__del_xm(m);
-	qreal bot = del2_E__del_x2m(m) - pow(del2_E__delxm_delym(m), 2.0) / del2_E__del_y2m(m);
+	m_layoutThreads = qMax( 0, threads );
+}
 
-	qreal result = top/bot;
-	//qDebug() << "dx" << result;
-	return result;
+int Graph::layoutThreads() const
+{
+	return m_layoutThreads;
 }
 
-//from kk89 eq 11, eq 12
-qreal Graph::dy(Vertex *m)
+void Graph::setRandomSeed( quint64 seed )
 {
-	qreal top = ((del2_E__delxm_delym(m)*del_E__del_xm(m))/del2_E__del_x2m(m))
-	            - del_E__del_ym(m);
-	qreal bot = del2_E__del_y2m(m) - pow(del2_E__delxm_delym(m), 2.0)/
-	                                 del2_E__del_x2m(m);
+	m_random.seed( seed );
+}
 
-	qreal result = top/bot;
-	//qDebug() << "dy" << result;
-	return result;
+void Graph::setRepulsionTheta( qreal theta )
+{
+	m_repulsionTheta = qMax( (qreal)0.0, theta );
 }
 
-//kk89 eq 9
-qreal Graph::delta_m(Vertex *m)
+qreal Graph::repulsionTheta() const
 {
-	qreal a = pow(del_E__del_xm(m), 2.0);
-	qreal b = pow(del_E__del_ym(m), 2.0);
-	return sqrt( a + b );
+	return m_repulsionTheta;
 }
 
+void Graph::setTelemetry( LayoutTelemetry *telemetry )
+{
+	m_telemetry = telemetry;
+}
 
-void Graph::layoutNGon()
+LayoutTelemetry* Graph::telemetry() const
 {
-	int n = m_vertices.size();
-	qreal inc = (2.0 * M_PI)/n;
-	qreal angle = 0.1;
-	for(QMap<uint,Vertex*>::const_iterator i = m_vertices.constBegin();
-	    i != m_vertices.constEnd(); ++i )
-	{
-		//qDebug() << *i << "set to" << QPointF(100.0*cos(angle),100.0*sin(angle));
-		(*i)->setNodePos( QPointF(100.0*cos(angle),100.0*sin(angle)) );
-		angle += inc;
+	return m_telemetry;
+}
+
+/* What one call of runKamadaKawai() may do, and what it did */
+struct KamadaKawaiRun {
+	int maxiter;
+	qreal epsilon;
+	/// stop once the clock reaches msecs, -1 for no deadline
+	QElapsedTimer clock;
+	qint64 msecs;
+	/// stop once the energy is this low, -1 for no target
+	qreal targetEnergy;
+	/// the number of the first step, afterwards one past the last one
+	int iteration;
+	/// the energy if it is known, -1 otherwise; kept up to date while
+	/// there is a target or telemetry
+	qreal energy;
+	bool converged;
+};
+
+/* The Newton iterations of layoutKamadaKawai(). With a NoTelemetry
+ * recorder every if( Recorder::Enabled ) block is dead code. */
+template<class Recorder>
+static void runKamadaKawai( KamadaKawaiLayout *kk, KamadaKawaiRun *run,
+                            Recorder &recorder )
+{
+	bool tracking = Recorder::Enabled || run->targetEnergy >= 0.0;
+	if( !tracking )
+		run->energy = -1.0;
+	else if( run->energy < 0.0 )
+		run->energy = kk->energy();
+	if( Recorder::Enabled )
+		recorder.start();
+	run->converged = false;
+	LayoutSample sample;
+	for(int i = 0; i < run->maxiter; ++i) {
+		if( run->msecs >= 0 && run->clock.elapsed() >= run->msecs )
+			break;
+		if( run->targetEnergy >= 0.0 && run->energy <= run->targetEnergy )
+			break;
+		int m = kk->maxVertex();
+		qreal curdx, curdy;
+		kk->newtonStep( m, &curdx, &curdy );
+		if( tracking )
+			run->energy += kk->energyChange( m, curdx, curdy );
+		kk->move( m, curdx, curdy );
+		if( Recorder::Enabled ) {
+			sample.iteration = run->iteration;
+			sample.vertex = m;
+			sample.energy = run->energy;
+			sample.maxDelta = kk->maxDelta();
+			sample.step = sqrt( curdx*curdx + curdy*curdy );
+			sample.evaluations = kk->evaluations();
+			recorder.record( sample );
+		}
+		++run->iteration;
+		if(qAbs(kk->delta_m(m)) < run->epsilon ) {
+			run->converged = true;
+			break;
+		}
 	}
 }
 
+/* Runs @p run, recording it into @p telemetry if there is one */
+static void runKamadaKawai( KamadaKawaiLayout *kk, KamadaKawaiRun *run,
+                            LayoutTelemetry *telemetry )
+{
+	if( telemetry ) {
+		runKamadaKawai( kk, run, *telemetry );
+	} else {
+		NoTelemetry none;
+		runKamadaKawai( kk, run, none );
+	}
+}
+
+/* The iterations of layoutFruchtermanReingold(), see runKamadaKawai() */
+template<class Recorder>
+static void runFruchtermanReingold( FruchtermanReingoldLayout *fr,
+                                    int maxiter, qreal epsilon,
+                                    Recorder &recorder )
+{
+	LayoutSample sample;
+	if( Recorder::Enabled ) {
+		recorder.start();
+		sample.vertex = -1;
+		sample.energy = -1.0;
+		sample.maxDelta = -1.0;
+		sample.evaluations = -1;
+	}
+	for(int iteration = 0; iteration < maxiter; ++iteration) {
+		qreal moved = fr->iterate();
+		if( Recorder::Enabled ) {
+			sample.iteration = iteration;
+			sample.step = moved;
+			recorder.record( sample );
+		}
+		if( moved < epsilon )
+			break;
+	}
+}
 
 void Graph::layoutRandom(qreal max)
 {
-#ifdef Q_OS_WIN
-    srand(21184);
-#endif
-	for(QMap<uint,Vertex*>::const_iterator i = m_vertices.constBegin();
-	    i != m_vertices.constEnd(); ++i )
-	{
-#ifdef Q_OS_WIN
-        qreal x = ((qreal)rand() / (qreal)RAND_MAX * max * 2 );
-		qreal y = ((qreal)rand() / (qreal)RAND_MAX * max * 2 );
-#else
-        qreal x = (drand48() * max * 2 ) -max;
-		qreal y = (drand48() * max * 2 ) -max;
-#endif
-        qDebug() << "pos:" << x << y;
-		(*i)->setNodePos( QPointF(x,y) );
+	for(int i = 0; i < m_core.size(); ++i) {
+		qreal x = ( m_random.uniform() * max * 2 ) - max;
+		qreal y = ( m_random.uniform() * max * 2 ) - max;
+		m_core.setPosition( i, x, y );
 	}
+	updateItems();
 }
 
-void Graph::layoutKamadaKawai( int maxiter, qreal epsilon, bool initialize)
+bool Graph::layoutKamadaKawai( int maxiter, qreal epsilon, bool initialize)
 {
-	qDebug() << "Laying out KamadaKawai";
+	if( !distances().isValid() )
+		return false;
 	if( initialize )
 		layoutRandom( 100.0 );
 		//layoutNGon();
 	if(maxiter < 0)
 		maxiter = 65536;
-	for(int iteration = 0; iteration < maxiter; ++iteration) {
-		uint id = 0;
-		qreal maxdelta_m = 0.0;
-		for(QMap<uint,Vertex*>::const_iterator i = m_vertices.constBegin();
-		    i != m_vertices.constEnd(); ++i )
-		{
-			qreal curdelta_m = qAbs(delta_m(*i));
-			//qDebug() << "curdelta_m,maxdelta_m"<< curdelta_m << "\t" << maxdelta_m;
-			if( curdelta_m >= maxdelta_m ) {
-				maxdelta_m = curdelta_m;
-				id = (*i)->id();
-			}
-		}
-		Vertex *m = m_vertices.value(id);
-		qreal curdx = dx(m);
-		qreal curdy = dy(m);
-		qDebug() << "Picked node with id=" << id <<", moving by" << QPointF(curdx,curdy) << " to "<< m->nodePos();
-		m->setNodePos( m->nodePos() + QPointF(curdx,curdy) );
-		if(qAbs(delta_m(m)) < epsilon ) {
-			qDebug() << "Breaking early: iteration, delta_m, epsilon" << iteration << qAbs(delta_m(m)) << epsilon;
-			break;
-		}
+	WorkerPool pool( m_layoutThreads );
+	KamadaKawaiLayout kk( this, &pool, m_repulsionTheta );
+	if( kk.size() == 0 )
+		return true;
+	KamadaKawaiRun run;
+	run.maxiter = maxiter;
+	run.epsilon = epsilon;
+	run.msecs = -1;
+	run.targetEnergy = -1.0;
+	run.iteration = 0;
+	run.energy = -1.0;
+	runKamadaKawai( &kk, &run, m_telemetry );
+	kk.apply();
+	return true;
+}
+
+bool Graph::layoutKamadaKawaiFor( int msecs, qreal epsilon,
+                                  KamadaKawaiCheckpoint *checkpoint,
+                                  qreal energy )
+{
+	//the budget includes the distances and the first gradients
+	KamadaKawaiRun run;
+	run.clock.start();
+	run.maxiter = INT_MAX;
+	run.epsilon = epsilon;
+	run.msecs = msecs;
+	run.targetEnergy = energy;
+	if( !distances().isValid() ) {
+		*checkpoint = KamadaKawaiCheckpoint();
+		return false;
 	}
+
+	WorkerPool pool( m_layoutThreads );
+	KamadaKawaiLayout *kk;
+	quint64 topology = m_core.topologyHash();
+	if( !checkpoint->isNull() && checkpoint->x.size() == m_core.size()
+	    && checkpoint->topology == topology ) {
+		kk = new KamadaKawaiLayout( this, *checkpoint, &pool,
+		                            m_repulsionTheta );
+		run.iteration = checkpoint->iteration;
+		run.energy = checkpoint->energy;
+	} else {
+		layoutRandom( 100.0 );
+		kk = new KamadaKawaiLayout( this, &pool, m_repulsionTheta );
+		run.iteration = 0;
+		run.energy = -1.0;
+	}
+	run.converged = true;
+	if( kk->size() > 0 )
+		runKamadaKawai( kk, &run, m_telemetry );
+	kk->apply();
+
+	kk->checkpoint( checkpoint );
+	checkpoint->topology = topology;
+	checkpoint->iteration = run.iteration;
+	checkpoint->energy = run.energy;
+	checkpoint->converged = run.converged;
+	delete kk;
+	return checkpoint->converged
+	       || ( energy >= 0.0 && run.energy <= energy );
 }
 
+void Graph::layoutMultilevel( int sweeps )
+{
+	WorkerPool pool( m_layoutThreads );
+	MultilevelLayout ml( this, &m_random, &pool, m_repulsionTheta );
+	ml.run( sweeps );
+	ml.apply();
+}
+
+void Graph::layoutStressSGD( int epochs, int pivots, bool initialize )
+{
+	if( initialize )
+		layoutRandom( 100.0 );
+	StressLayout stress( this, &m_random, pivots );
+	stress.run( epochs );
+	stress.apply();
+}
+
+void Graph::layoutFruchtermanReingold( int maxiter, qreal epsilon,
+                                       bool initialize, qreal cooling )
+{
+	//the repulsion only reaches two edge lengths, so start about as spread
+	//out as the result, not crammed into a few cells
+	if( initialize )
+		layoutRandom( 50.0 * sqrt( (qreal)m_core.size() ) );
+	WorkerPool pool( m_layoutThreads );
+	FruchtermanReingoldLayout fr( this, &pool );
+	fr.setCooling( cooling );
+	if( m_telemetry ) {
+		runFruchtermanReingold( &fr, maxiter, epsilon, *m_telemetry );
+	} else {
+		NoTelemetry none;
+		runFruchtermanReingold( &fr, maxiter, epsilon, none );
+	}
+	fr.apply();
+}
@@ -13,6 +13,15 @@
 #include <QtCore/QList>
 #include <QtCore/QMap>
 #include <QtCore/QPair>
+#include <QtCore/QSizeF>
+#include <QtCore/QString>
+
+#include <QtCore/QVector>
+
+#include "DistanceMatrix.h"
+#include "GraphCore.h"
+#include "ItemArena.h"
+#include "RandomGenerator.h"
 
 class QTextStream;
 class QGraphicsItem;
@@ -20,6 +29,14 @@ class QPointF;
 
 class Vertex;
 class Edge;
+class EdgeLayer;
+class GraphViewport;
+class GraphReader;
+class LayoutTelemetry;
+struct KamadaKawaiCheckpoint;
+
+/** the desirable length of an edge, L in kk89, shared by all layouts */
+static const qreal EDGELENGTH = 100.0;
 
 class Graph //: public QObject
 {
@@ -29,26 +46,116 @@ public:
 	enum LayoutAlgorithm {
 		NGon, ///< Lays out graph as a regular n-gon
 		Random, ///< Lays out nodes randomly
-		KamadaKawai ///< Uses the Kamada-Kawai spring-based algorithm
+		KamadaKawai, ///< Uses the Kamada-Kawai spring-based algorithm
+		Multilevel, ///< Lays out a coarsened graph and refines it level by level
+		StressSGD, ///< Minimizes the Kamada-Kawai stress by stochastic gradient descent
+		FruchtermanReingold ///< Cheap force-directed layout with a grid
 	};
 	/** ctor */
 	Graph();
+	/**
+	 * Creates a headless graph, one without any vertex or edge items, to
+	 * lay out @p core where there is no display. vertex(), vertexAt() and
+	 * the like return 0 and no items may be added to it.
+	 * @param labels the texts of the vertices, indexed like @p core
+	 */
+	Graph( const GraphCore &core, const QVector<QString> &labels );
+	/**
+	 * Deletes the vertex and edge items that are left. Each one takes
+	 * itself out of its scene, so this is O(n + m) like clearing a scene;
+	 * their memory then goes back a slab at a time. An EdgeLayer or
+	 * GraphViewport of the graph must be deleted first.
+	 */
+	~Graph();
+	/** @return true if the graph was made without items */
+	bool isHeadless() const;
+	/** @return where the vertex items live, see Vertex::operator new */
+	ItemArena* vertexArena();
+	/** @return where the edge items live, see Edge::operator new */
+	ItemArena* edgeArena();
+	/**
+	 * @return the topology and positions of the graph, indexed like
+	 * vertexAt() and edgeAt(). Layouts work on this and call updateItems()
+	 * when they are done.
+	 */
+	GraphCore* core();
+	const GraphCore* core() const;
+
+	/** @return the vertex with id @p id, 0 if there is none */
+	Vertex* vertex( uint id ) const;
+	/** @return the edge between the vertices with ids @p a and @p b, or 0 */
+	Edge* edge( uint a, uint b ) const;
+	/** @return the vertex with index @p i in core() */
+	Vertex* vertexAt( int i ) const;
+	/** @return the edge with index @p e in core() */
+	Edge* edgeAt( int e ) const;
+	/** @return all vertices in the order of their index */
+	const QVector<Vertex*>& vertexItems() const;
+	/** @return all edges in the order of their index, each one once */
+	const QVector<Edge*>& edgeItems() const;
+
 	/**
 	 * @return a map of ids to the vertex pointers of the graph
+	 * @note this is built on every call, use vertex() or vertexItems()
 	 */
 	QMap<uint,Vertex*> vertices() const;
 	/**
 	 * @return a map of vertex pairs to edges in the graph
 	 * @note in an undirected graph both head,tail and tail,head should be checked
+	 * @note this is built on every call, use edgeItems()
 	 */
 	QMap<QPair<Vertex*,Vertex*>,Edge*> edges() const;
 
-	void vertexAdded( Vertex* v );
-	void edgeAdded( Edge* e );
+	void vertexAdded( Vertex* v, const QPointF &pos );
+	void edgeAdded( Edge* e, qreal weight );
 
+	/** removes @p v and deletes all of its edges, called by ~Vertex() */
 	void vertexRemoved( Vertex* v );
+	/** removes @p e, called by ~Edge() */
 	void edgeRemoved( Edge* e );
 
+	void edgeChanged( Edge* e );
+
+	/**
+	 * Moves the vertex and edge items to the positions in core(), in one
+	 * pass over the items of the vertices that moved and their edges. If
+	 * many moved, the index of their scene is switched off during the pass
+	 * and rebuilt once at the end. Inside a transaction this waits for
+	 * the commit.
+	 */
+	void updateItems();
+
+	/**
+	 * Starts a batch of moves. Until the matching commit(),
+	 * Vertex::setNodePos() and the layouts only change core(), and the
+	 * items are left where they are. Transactions nest, only the outermost
+	 * commit() moves the items.
+	 * @see LayoutTransaction
+	 */
+	void beginTransaction();
+	/** Ends a transaction, moving the items if it was the outermost one */
+	void commit();
+	/** @return true between beginTransaction() and its commit() */
+	bool isInTransaction() const;
+
+	/**
+	 * Sets the item that draws all edges at once, which is told when the
+	 * vertices move. The Edge items are then only moved if they are in a
+	 * scene themselves. Done by the EdgeLayer constructor.
+	 * @param layer the layer, or 0 for none
+	 */
+	void setEdgeLayer( EdgeLayer *layer );
+	/** @return the edge layer of the graph, 0 if there is none */
+	EdgeLayer* edgeLayer() const;
+	/**
+	 * Sets the viewport that shows the vertices of a headless graph, which
+	 * is told when they move. Done by the GraphViewport constructor.
+	 * @param viewport the viewport, or 0 for none
+	 */
+	void setViewport( GraphViewport *viewport );
+	/** @return the viewport of the graph, 0 if there is none */
+	GraphViewport* viewport() const;
+
 #if 0
 	/**
 	 * Get the value of L, the desirable length of an edge
@@ -63,7 +170,28 @@ public:
 	void setL(qreal L);
 #endif
 
+	/**
+	 * @return the graph-theoretic distances between all vertices, indexed
+	 * like core(). They are computed on first use and kept
+	 * until a vertex or edge is added or removed. The matrix is invalid if
+	 * the graph is too large for it, see DistanceMatrix::compute().
+	 */
+	const DistanceMatrix& distances();
+	/**
+	 * Sets how distances() stores its matrix. Packed storage takes about a
+	 * quarter of the memory, which matters for graphs of 10k+ vertices.
+	 * @param storage the new storage, Automatic by default
+	 */
+	void setDistanceStorage( DistanceMatrix::Storage storage );
+	/** @return how distances() stores its matrix */
+	DistanceMatrix::Storage distanceStorage() const;
+
 	bool isValidNewId(uint id) const;
+	/**
+	 * @return an id no vertex has, for a new vertex. They are handed out
+	 * in order, so a run of new vertices costs a lookup each.
+	 */
+	uint newId();
 	/**
 	 * @brief Reads a graph from a format based on DOT
 	 *
@@ -80,8 +208,12 @@ public:
 	125367 [label="NODE2",pos="5.43 3.21"];
 	122453 -- 125367 [weight="2.3"];
 
-	 * note that statements must be on seperate lines and nodes must be declared
-	 * before use, unlike in DOT where they can be defined implicitly.
+	 * note that statements must be on seperate lines and nodes must be declared,
+	 * unlike in DOT where they can be defined implicitly. An edge may come
+	 * before the nodes it joins. Numbers
+	 * may have a sign and an exponent, and \" in a label stands for ".
+	 * Statements that can't be read are logged with their line number and
+	 * skipped, see GraphReader.
 	 * @note it's your responsibility to delete the graph when you're finished
 	 * @note do not give it a stream from stdin, it will cause an infinite loop
 	 * @param s the stream to read from
@@ -89,6 +221,22 @@ public:
 	 * @return a pointer to the new Graph object
 	 */
 	static Graph* readGraph(QTextStream *s, QGraphicsItem *parent = 0);
+	/**
+	 * @brief Reads a graph from the file @p fileName
+	 * This is the faster way for large files, they are memory-mapped and
+	 * may be parsed in pieces on several threads.
+	 * @see readGraph
+	 * @param threads the number of threads parsing, 0 = one per core
+	 */
+	static Graph* readGraph(const QString &fileName, QGraphicsItem *parent = 0,
+	                        int threads = 1);
+	/**
+	 * @brief Reads a graph from the file @p fileName without making items
+	 * Either format is read, binary files are told apart by their magic.
+	 * @return a headless graph, 0 if the file couldn't be read
+	 * @param threads the number of threads parsing, 0 = one per core
+	 */
+	static Graph* readHeadlessGraph(const QString &fileName, int threads = 1);
 	/**
 	 * @brief Writes a graph to a format based on DOT
 	 * This function writes @param g into @param s
@@ -97,6 +245,76 @@ public:
 	 * @param g the graph to write
 	 */
 	static void  writeGraph(QTextStream *s, Graph *g);
+	/**
+	 * @brief Writes the vertices and edges of @p core with the vertex
+	 * labels @p labels, see writeGraph()
+	 */
+	static void  writeGraph(QTextStream *s, const GraphCore &core,
+	                        const QVector<QString> &labels);
+
+	/**
+	 * @brief Reads a graph from the binary format of BinaryGraph
+	 * The file is mapped and its arrays are used as they are, nothing
+	 * is parsed.
+	 * @return the new graph, or 0 if the file can't be read
+	 */
+	static Graph* readBinaryGraph(const QString &fileName,
+	                              QGraphicsItem *parent = 0);
+	/**
+	 * @brief Writes @p g in the binary format of BinaryGraph
+	 * @return false if the file can't be written
+	 */
+	static bool writeBinaryGraph(const QString &fileName, Graph *g);
+
+	/**
+	 * Creates a graph with an item for each vertex and edge of @p core.
+	 * The vertices keep their ids, 0 included.
+	 * @param labels the texts of the vertices, indexed like @p core
+	 * @param parent the parent item of the new vertices
+	 */
+	static Graph* fromCore(const GraphCore &core, const QVector<QString> &labels,
+	                       QGraphicsItem *parent = 0);
+	/** @return the texts of the vertices, indexed like core() */
+	QVector<QString> labels() const;
+	/**
+	 * @return the sizes of the boxes of the vertices, indexed like core(),
+	 * for layouts that keep vertices apart. Each text is only measured
+	 * once; without a QApplication, or off its thread, the texts not
+	 * measured yet are estimated, see LabelMetrics.
+	 */
+	QVector<QSizeF> labelSizes() const;
+
+	/**
+	 * Sets the number of threads the layouts may use
+	 * @param threads the number of threads, 0 = one per core
+	 */
+	void setLayoutThreads( int threads );
+	/** @return the number of threads the layouts may use, 0 = one per core */
+	int layoutThreads() const;
+	/**
+	 * Restarts the random numbers used by the layouts. A layout started
+	 * with the same seed and number of threads gives the same result.
+	 */
+	void setRandomSeed( quint64 seed );
+
+	/**
+	 * Sets the Barnes-Hut opening criterion for the repulsion between all
+	 * vertices in the Kamada-Kawai layout of large graphs
+	 * @param theta 0 to always sum exactly, 0.5 to 1.0 are useful values
+	 */
+	void setRepulsionTheta( qreal theta );
+	/** @return the Barnes-Hut opening criterion, 0.7 by default */
+	qreal repulsionTheta() const;
+
+	/**
+	 * Records every iteration of layoutKamadaKawai() and
+	 * layoutFruchtermanReingold() into @p telemetry, which the graph does
+	 * not own. The energy is only tracked while recording, at O(n) per
+	 * iteration and O(n²) once at the start.
+	 * @param telemetry where to record, 0 to stop recording (the default)
+	 */
+	void setTelemetry( LayoutTelemetry *telemetry );
+	LayoutTelemetry* telemetry() const;
 
 	void layoutNGon();
 	void layoutRandom(qreal max);
@@ -106,28 +324,99 @@ public:
 	 * @param maxiter the maximum number of iterations, -1 = until epsilon
 	 * @param epsilon epsilon
 	 * @param initialize if true, lay out the initial position as a regular
-	 * n-sided polygon, where n is the number of vertices*/
-	void layoutKamadaKawai(int maxiter, qreal epsilon, bool initialize);
+	 * n-sided polygon, where n is the number of vertices
+	 * @return false if the graph is too large for the distances of all
+	 * pairs, the vertices are left alone then */
+	bool layoutKamadaKawai(int maxiter, qreal epsilon, bool initialize);
+	/**
+	 * Lays out the graph using Kamada-Kawai until a deadline, and leaves
+	 * the vertices where it got to. The state is saved to @p checkpoint,
+	 * and a later call carries on from there, so a layout can be given
+	 * out while it is still being refined.
+	 * @param msecs the wall clock budget in milliseconds, including the
+	 * setup of a new layout, -1 for none
+	 * @param epsilon stop once the moved vertex has a delta_m below this
+	 * @param checkpoint the layout to resume, or a null one to start
+	 * from random positions; it is overwritten with the new state. It
+	 * doesn't carry over to another graph, or if vertices or edges were
+	 * added or removed in between. Only a new start draws random numbers,
+	 * as layoutRandom() does; resuming leaves them alone.
+	 * @param energy stop once the energy is this low, -1 for no target.
+	 * Tracking the energy takes an O(n²) sum at the start and O(n) per step.
+	 * @return true if the layout converged or reached @p energy, false if
+	 * it ran out of time, or if the graph is too large for the distances
+	 * of all pairs; @p checkpoint is null then
+	 */
+	bool layoutKamadaKawaiFor(int msecs, qreal epsilon,
+	                          KamadaKawaiCheckpoint *checkpoint,
+	                          qreal energy = -1.0);
+	/**
+	 * Lays out the graph by collapsing it into ever smaller graphs, laying
+	 * out the smallest one with Kamada-Kawai and refining the positions
+	 * on the way back up. The current positions are not used.
+	 * @param sweeps the maximum number of force-directed sweeps per level
+	 */
+	void layoutMultilevel(int sweeps);
+	/**
+	 * Lays out the graph by stochastic gradient descent on the stress,
+	 * moving every vertex in every epoch
+	 * @param epochs the number of passes over all pairs, 30 is plenty
+	 * @param pivots the number of pivots that stand in for most pairs, 0 to
+	 * use all pairs, -1 to use all pairs only for small graphs
+	 * @param initialize if true, start from random positions
+	 */
+	void layoutStressSGD(int epochs, int pivots, bool initialize);
+	/**
+	 * Lays out the graph using the grid variant of Fruchterman-Reingold
+	 * @param maxiter the maximum number of iterations
+	 * @param epsilon stop once no vertex moves farther than this
+	 * @param initialize if true, start from random positions
+	 * @param cooling the factor the temperature is multiplied with after
+	 * each iteration
+	 */
+	void layoutFruchtermanReingold(int maxiter, qreal epsilon,
+	                               bool initialize, qreal cooling = 0.95);
+private:
+	/** builds the graph read by @p reader and logs its errors */
+	static Graph* buildGraph( GraphReader *reader, QGraphicsItem *parent,
+	                          bool headless = false );
+
+	GraphCore m_core;
+	QVector<Vertex*> m_vertexItems;
+	QVector<Edge*> m_edgeItems;
+	DistanceMatrix m_distances;
+	DistanceMatrix::Storage m_distanceStorage;
+	RandomGenerator m_random;
+	int m_layoutThreads;
+	qreal m_repulsionTheta;
+	LayoutTelemetry *m_telemetry;
+	/// the vertex texts of a headless graph
+	QVector<QString> m_labels;
+	/// the depth of nested transactions
+	int m_transactions;
+	/// where newId() goes on looking
+	uint m_nextId;
+	EdgeLayer *m_edgeLayer;
+	GraphViewport *m_viewport;
+	/// made by the headless ctor, even an empty one never gets items
+	bool m_headless;
+	/// the memory of the items, empty once the destructor has run
+	ItemArena m_vertexArena;
+	ItemArena m_edgeArena;
+
+	Q_DISABLE_COPY( Graph )
+};
+
+/**
+ * @brief Keeps a Graph in a transaction for as long as it lives
+ */
+class LayoutTransaction
+{
+public:
+	LayoutTransaction( Graph *g ) : m_graph( g ) { m_graph->beginTransaction(); }
+	~LayoutTransaction() { m_graph->commit(); }
 private:
-	//functions for implementing Kamada-Kawai algorithm
-	inline qreal kij( Vertex *i, Vertex *j );
-    // the weight of an edge between two points
-	inline qreal lij( Vertex *i, Vertex *j );
-    // the distance of two points
-	inline qreal distanceVertex( Vertex *i, Vertex *j );
-   inline qreal distancePoint( const QPointF& i, const QPointF& j );
-
-	qreal del_E__del_xm(Vertex *m);
-	qreal del_E__del_ym(Vertex *m);
-	qreal del2_E__del_x2m(Vertex *m);
-	qreal del2_E__delxm_delym(Vertex *m);
-	qreal del2_E__del_y2m(Vertex *m);
-	qreal dx(Vertex *m);
-	qreal dy(Vertex *m);
-	qreal delta_m(Vertex *m);
-
-	QMap<uint,Vertex*> m_vertices;
-	QMap<QPair<Vertex*,Vertex*>,Edge*> m_edges;
+	Graph *m_graph;
 };
 
 #endif //include guard
@@ -0,0 +1,224 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "GraphBuilder.h"
+
+#include <climits>
+
+// C++ std lib for sorting the edges
+#include <algorithm>
+
+// QtCore
+#include <QtCore/QSet>
+
+#include "EdgeTable.h"
+#include "GraphCore.h"
+#include "LabelMetrics.h"
+
+/* An edge by the unordered pair of its ends, for finding repeats */
+struct PairKey {
+	quint64 pair;
+	int edge;
+	/* repeats end up next to each other, the first added in front */
+	bool operator<( const PairKey &other ) const
+	{
+		return pair < other.pair
+		       || ( pair == other.pair && edge < other.edge );
+	}
+};
+
+GraphBuilder::GraphBuilder()
+{
+	m_repeated = 0;
+	m_newIds = true;
+}
+
+void GraphBuilder::setNewIds( bool newIds )
+{
+	m_newIds = newIds;
+}
+
+void GraphBuilder::reserve( int vertices, int edges )
+{
+	m_vertices.reserve( vertices );
+	m_edges.reserve( edges );
+}
+
+int GraphBuilder::addVertex( uint id, qreal x, qreal y, const QString &label )
+{
+	VertexRecord v;
+	v.id = id;
+	v.x = x;
+	v.y = y;
+	v.label = label;
+	v.idLabel = false;
+	m_vertices.append( v );
+	return m_vertices.size() - 1;
+}
+
+int GraphBuilder::addVertices( int count )
+{
+	int first = m_vertices.size();
+	VertexRecord v;
+	v.id = 0;
+	v.x = v.y = 0.0;
+	v.idLabel = true;
+	m_vertices.reserve( first + count );
+	for(int i = 0; i < count; ++i)
+		m_vertices.append( v );
+	return first;
+}
+
+void GraphBuilder::addEdge( int head, int tail, qreal weight )
+{
+	EdgeRecord e;
+	e.head = head;
+	e.tail = tail;
+	e.weight = weight;
+	e.byId = false;
+	m_edges.append( e );
+}
+
+void GraphBuilder::addEdgeById( uint a, uint b, qreal weight )
+{
+	EdgeRecord e;
+	e.head = a;
+	e.tail = b;
+	e.weight = weight;
+	e.byId = true;
+	m_edges.append( e );
+}
+
+void GraphBuilder::addEdges( const QVector<QPair<int,int> > &edges )
+{
+	m_edges.reserve( m_edges.size() + edges.size() );
+	for(int e = 0; e < edges.size(); ++e)
+		addEdge( edges.at(e).first, edges.at(e).second );
+}
+
+int GraphBuilder::vertexCount() const
+{
+	return m_vertices.size();
+}
+
+int GraphBuilder::edgeCount() const
+{
+	return m_edges.size();
+}
+
+void GraphBuilder::assignIds()
+{
+	uint largest = 0;
+	int missing = 0;
+	for(int v = 0; v < m_vertices.size(); ++v) {
+		largest = qMax( largest, m_vertices.at(v).id );
+		if( m_vertices.at(v).id == 0 )
+			++missing;
+	}
+	if( missing == 0 )
+		return;
+
+	uint next = largest + 1;
+	//only ids close to 2^32 leave no room past the largest, then the
+	//gaps below it are used
+	QSet<uint> used;
+	if( (quint64)largest + missing > UINT_MAX ) {
+		for(int v = 0; v < m_vertices.size(); ++v)
+			used.insert( m_vertices.at(v).id );
+		next = 1;
+	}
+	for(int v = 0; v < m_vertices.size(); ++v) {
+		if( m_vertices.at(v).id != 0 )
+			continue;
+		while( used.contains( next ) )
+			++next;
+		m_vertices[v].id = next++;
+	}
+}
+
+void GraphBuilder::build( GraphCore *core, QVector<QString> *labels )
+{
+	Q_ASSERT( core->size() == 0 );
+	m_duplicates.clear();
+	m_dangling.clear();
+	m_repeated = 0;
+	if( m_newIds )
+		assignIds();
+
+	int n = m_vertices.size();
+	int m = m_edges.size();
+	core->reserve( n, m );
+	labels->reserve( labels->size() + n );
+	//equal labels share their string
+	LabelPool pool;
+	QVector<int> index( n, -1 );
+	for(int v = 0; v < n; ++v) {
+		const VertexRecord &r = m_vertices.at(v);
+		if( core->index( r.id ) >= 0 ) {
+			m_duplicates.append( v );
+			continue;
+		}
+		index[v] = core->addVertex( r.id, r.x, r.y );
+		labels->append( pool.intern( r.idLabel ? QString::number( r.id )
+		                                       : r.label ) );
+	}
+
+	QVector<int> heads( m, -1 );
+	QVector<int> tails( m, -1 );
+	QVector<PairKey> keys;
+	keys.reserve( m );
+	for(int e = 0; e < m; ++e) {
+		const EdgeRecord &r = m_edges.at(e);
+		int h, t;
+		if( r.byId ) {
+			h = core->index( r.head );
+			t = core->index( r.tail );
+		} else {
+			h = r.head < (uint)n ? index.at( r.head ) : -1;
+			t = r.tail < (uint)n ? index.at( r.tail ) : -1;
+		}
+		if( h < 0 || t < 0 ) {
+			m_dangling.append( e );
+			continue;
+		}
+		heads[e] = h;
+		tails[e] = t;
+		PairKey key;
+		key.pair = EdgeTable::key( h, t );
+		key.edge = e;
+		keys.append( key );
+	}
+	std::sort( keys.begin(), keys.end() );
+
+	QVector<bool> keep( m, false );
+	for(int k = 0; k < keys.size(); ++k) {
+		if( k > 0 && keys.at(k).pair == keys.at(k-1).pair )
+			++m_repeated;
+		else
+			keep[ keys.at(k).edge ] = true;
+	}
+	for(int e = 0; e < m; ++e)
+		if( keep.at(e) )
+			core->addEdge( heads.at(e), tails.at(e), m_edges.at(e).weight );
+}
+
+const QVector<int>& GraphBuilder::duplicateVertices() const
+{
+	return m_duplicates;
+}
+
+const QVector<int>& GraphBuilder::danglingEdges() const
+{
+	return m_dangling;
+}
+
+int GraphBuilder::repeatedEdges() const
+{
+	return m_repeated;
+}
@@ -0,0 +1,116 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef GRAPHBUILDER_H
+#define GRAPHBUILDER_H
+
+#include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class GraphCore;
+
+/**
+ * @brief Collects the vertices and edges of a graph and adds them at once
+ *
+ * Adding a graph to a GraphCore edge by edge means a lookup per edge to
+ * skip the ones already there. This only appends to arrays until build(),
+ * which then makes the whole graph in one pass: the vertices without an
+ * id get sequential ones past the largest given, the edges are sorted by
+ * their pair of ends so repeated ones can be dropped, and the rest are
+ * added to a core that already has room for all of them. That is
+ * O(n + m log m) for n vertices and m edges.
+ *
+ * Vertices are numbered 0, 1, ... in the order they are added; edges may
+ * name their ends by those numbers or by ids.
+ */
+class GraphBuilder
+{
+public:
+	GraphBuilder();
+
+	/** Makes room for this many vertices and edges in all */
+	void reserve( int vertices, int edges );
+	/**
+	 * @param newIds false to take id 0 as an ordinary id, as files do;
+	 * true by default
+	 */
+	void setNewIds( bool newIds );
+
+	/**
+	 * Adds a vertex
+	 * @param id the id of the vertex, 0 to get a new one in build()
+	 * unless setNewIds( false ) was called
+	 * @return the number of the vertex
+	 */
+	int addVertex( uint id, qreal x = 0.0, qreal y = 0.0,
+	               const QString &label = QString() );
+	/**
+	 * Adds @p count vertices at the origin, with new ids and their ids as
+	 * labels
+	 * @return the number of the first one
+	 */
+	int addVertices( int count );
+
+	/** Adds an edge between the vertices numbered @p head and @p tail */
+	void addEdge( int head, int tail, qreal weight = 1.0 );
+	/** Adds an edge between the vertices with ids @p a and @p b */
+	void addEdgeById( uint a, uint b, qreal weight = 1.0 );
+	/** Adds pairs of vertex numbers as edges of weight 1 */
+	void addEdges( const QVector<QPair<int,int> > &edges );
+
+	/** @return the number of vertices added */
+	int vertexCount() const;
+	/** @return the number of edges added, repeated ones included */
+	int edgeCount() const;
+
+	/**
+	 * Adds the vertices and edges to the empty @p core, and the labels of
+	 * the vertices to @p labels. Equal labels share their string.
+	 *
+	 * A vertex whose id is taken by an earlier one is left out, and so
+	 * are edges with an end that is left out or doesn't exist. Of the
+	 * edges joining the same pair, in either direction, the first one
+	 * added is kept. The edges keep the order they were added in.
+	 */
+	void build( GraphCore *core, QVector<QString> *labels );
+
+	/** @return the vertices left out by build() for their id */
+	const QVector<int>& duplicateVertices() const;
+	/** @return the edges left out by build() for a missing end */
+	const QVector<int>& danglingEdges() const;
+	/** @return the number of edges build() dropped as repeats */
+	int repeatedEdges() const;
+
+private:
+	struct VertexRecord {
+		uint id;
+		qreal x, y;
+		QString label;
+		/// the label is the id, once there is one
+		bool idLabel;
+	};
+	struct EdgeRecord {
+		/// vertex numbers, or ids if byId
+		uint head, tail;
+		qreal weight;
+		bool byId;
+	};
+
+	/** gives the vertices with id 0 new ones */
+	void assignIds();
+
+	QVector<VertexRecord> m_vertices;
+	QVector<EdgeRecord> m_edges;
+	QVector<int> m_duplicates;
+	QVector<int> m_dangling;
+	int m_repeated;
+	bool m_newIds;
+};
+
+#endif //include guard
@@ -0,0 +1,384 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "GraphCore.h"
+
+// C++ std lib for the bits of a weight
+#include <cstring>
+
+// the smallest weight of an edge, lighter ones would make distances of 0
+static const qreal MINWEIGHT = 0.001;
+
+/* Weights are lengths to the distances, so they must be positive. NaN
+ * fails the comparison too. */
+static inline qreal positiveWeight( qreal weight )
+{
+	return weight >= MINWEIGHT ? weight : MINWEIGHT;
+}
+
+/* Folds @p value into the hash @p h, as boost::hash_combine does */
+static inline quint64 combine( quint64 h, quint64 value )
+{
+	return h ^ ( value + Q_UINT64_C( 0x9e3779b97f4a7c15 )
+	             + ( h << 6 ) + ( h >> 2 ) );
+}
+
+GraphCore::GraphCore()
+{
+	m_tableValid = true;
+	m_rowsValid = false;
+}
+
+int GraphCore::size() const
+{
+	return m_ids.size();
+}
+
+int GraphCore::edgeCount() const
+{
+	return m_head.size();
+}
+
+void GraphCore::reserve( int vertices, int edges )
+{
+	m_ids.reserve( vertices );
+	m_index.reserve( vertices );
+	m_x.reserve( vertices );
+	m_y.reserve( vertices );
+	m_head.reserve( edges );
+	m_tail.reserve( edges );
+	m_weight.reserve( edges );
+	if( m_tableValid )
+		m_table.reserve( edges );
+}
+
+int GraphCore::addVertex( uint id, qreal x, qreal y )
+{
+	int i = m_ids.size();
+	m_ids.append( id );
+	m_index.insert( id, i );
+	m_x.append( x );
+	m_y.append( y );
+	m_rowsValid = false;
+	return i;
+}
+
+int GraphCore::removeVertex( int i )
+{
+	Q_ASSERT( degree( i ) == 0 );
+	int last = m_ids.size() - 1;
+	m_index.remove( m_ids.at(i) );
+	int moved = -1;
+	if( i != last ) {
+		m_ids[i] = m_ids.at(last);
+		m_x[i] = m_x.at(last);
+		m_y[i] = m_y.at(last);
+		m_index.insert( m_ids.at(i), i );
+		//the edges of the moved vertex follow it
+		updateRows();
+		for(int k = m_offsets.at(last); k < m_offsets.at(last+1); ++k) {
+			int e = m_edges.at(k);
+			if( m_head.at(e) == last )
+				m_head[e] = i;
+			if( m_tail.at(e) == last )
+				m_tail[e] = i;
+		}
+		moved = last;
+	}
+	m_ids.remove( last );
+	m_x.remove( last );
+	m_y.remove( last );
+	m_rowsValid = false;
+	return moved;
+}
+
+int GraphCore::index( uint id ) const
+{
+	return m_index.value( id, -1 );
+}
+
+uint GraphCore::id( int i ) const
+{
+	return m_ids.at(i);
+}
+
+qreal GraphCore::x( int i ) const
+{
+	return m_x.at(i);
+}
+
+qreal GraphCore::y( int i ) const
+{
+	return m_y.at(i);
+}
+
+void GraphCore::setPosition( int i, qreal x, qreal y )
+{
+	m_x[i] = x;
+	m_y[i] = y;
+}
+
+const QVector<qreal>& GraphCore::xs() const
+{
+	return m_x;
+}
+
+const QVector<qreal>& GraphCore::ys() const
+{
+	return m_y;
+}
+
+bool GraphCore::assign( int n, const quint32 *ids, const double *x,
+                        const double *y, int m, const quint32 *heads,
+                        const quint32 *tails, const double *weights )
+{
+	Q_ASSERT( m_ids.isEmpty() && m_head.isEmpty() );
+	m_ids = QVector<uint>( n );
+	m_x = QVector<qreal>( n );
+	m_y = QVector<qreal>( n );
+	m_index.reserve( n );
+	for(int i = 0; i < n; ++i) {
+		m_ids[i] = ids[i];
+		m_x[i] = x[i];
+		m_y[i] = y[i];
+		m_index.insert( ids[i], i );
+	}
+	m_head = QVector<int>( m );
+	m_tail = QVector<int>( m );
+	m_weight = QVector<qreal>( m );
+	for(int e = 0; e < m; ++e) {
+		m_head[e] = heads[e];
+		m_tail[e] = tails[e];
+		m_weight[e] = positiveWeight( weights[e] );
+	}
+	m_table.clear();
+	m_tableValid = false;
+	m_rowsValid = false;
+	return m_index.size() == n;
+}
+
+void GraphCore::setPositions( const QVector<qreal> &x,
+                              const QVector<qreal> &y )
+{
+	Q_ASSERT( x.size() == m_ids.size() && y.size() == m_ids.size() );
+	m_x = x;
+	m_y = y;
+}
+
+int GraphCore::addEdge( int head, int tail, qreal weight )
+{
+	weight = positiveWeight( weight );
+	m_head.append( head );
+	m_tail.append( tail );
+	m_weight.append( weight );
+	//a table built later takes the edge from the list
+	if( m_tableValid )
+		m_table.insert( m_ids.at(head), m_ids.at(tail), m_head.size() - 1,
+		                weight );
+	m_rowsValid = false;
+	return m_head.size() - 1;
+}
+
+int GraphCore::removeEdge( int e )
+{
+	int last = m_head.size() - 1;
+	uint a = m_ids.at( m_head.at(e) ), b = m_ids.at( m_tail.at(e) );
+	//a parallel edge may have taken over the entry, or may take it over
+	if( m_tableValid && m_table.edge( a, b ) == e ) {
+		int other = parallelEdge( e );
+		if( other >= 0 )
+			m_table.insert( a, b, other, m_weight.at(other) );
+		else
+			m_table.remove( a, b );
+	}
+	int moved = -1;
+	if( e != last ) {
+		m_head[e] = m_head.at(last);
+		m_tail[e] = m_tail.at(last);
+		m_weight[e] = m_weight.at(last);
+		moved = last;
+	}
+	m_head.remove( last );
+	m_tail.remove( last );
+	m_weight.remove( last );
+	if( moved >= 0 && m_tableValid ) {
+		//the moved edge may now come before a parallel one
+		a = m_ids.at( m_head.at(e) );
+		b = m_ids.at( m_tail.at(e) );
+		if( m_table.edge( a, b ) == last ) {
+			int f = qMax( e, parallelEdge( e ) );
+			m_table.insert( a, b, f, m_weight.at(f) );
+		}
+	}
+	m_rowsValid = false;
+	return moved;
+}
+
+/* Every edge beyond the pairs in the table is parallel to another one, so
+ * a simple graph never gets to the scan. The highest index wins, as it
+ * does in the table. */
+int GraphCore::parallelEdge( int e ) const
+{
+	if( m_head.size() <= m_table.size() )
+		return -1;
+	quint64 pair = EdgeTable::key( m_head.at(e), m_tail.at(e) );
+	for(int f = m_head.size() - 1; f >= 0; --f)
+		if( f != e && EdgeTable::key( m_head.at(f), m_tail.at(f) ) == pair )
+			return f;
+	return -1;
+}
+
+int GraphCore::head( int e ) const
+{
+	return m_head.at(e);
+}
+
+int GraphCore::tail( int e ) const
+{
+	return m_tail.at(e);
+}
+
+qreal GraphCore::weight( int e ) const
+{
+	return m_weight.at(e);
+}
+
+void GraphCore::setWeight( int e, qreal weight )
+{
+	weight = positiveWeight( weight );
+	m_weight[e] = weight;
+	uint a = m_ids.at( m_head.at(e) ), b = m_ids.at( m_tail.at(e) );
+	if( m_tableValid && m_table.edge( a, b ) == e )
+		m_table.setWeight( a, b, weight );
+	if( m_rowsValid ) {
+		//patch the two entries instead of rebuilding
+		for(int end = 0; end < 2; ++end) {
+			int i = end ? m_tail.at(e) : m_head.at(e);
+			for(int k = m_offsets.at(i); k < m_offsets.at(i+1); ++k)
+				if( m_edges.at(k) == e )
+					m_weights[k] = weight;
+		}
+	}
+}
+
+int GraphCore::findEdge( uint a, uint b ) const
+{
+	updateTable();
+	return m_table.edge( a, b );
+}
+
+qreal GraphCore::edgeWeight( uint a, uint b, qreal missing ) const
+{
+	updateTable();
+	return m_table.weight( a, b, missing );
+}
+
+/* In edge order, so the highest index of parallel edges wins */
+void GraphCore::updateTable() const
+{
+	if( m_tableValid )
+		return;
+	m_table.clear();
+	m_table.reserve( m_head.size() );
+	for(int e = 0; e < m_head.size(); ++e)
+		m_table.insert( m_ids.at( m_head.at(e) ), m_ids.at( m_tail.at(e) ),
+		                e, m_weight.at(e) );
+	m_tableValid = true;
+}
+
+/* A counting sort of the edge ends by vertex */
+void GraphCore::updateRows() const
+{
+	if( m_rowsValid )
+		return;
+	int n = m_ids.size();
+	int m = m_head.size();
+	m_offsets = QVector<int>( n + 1, 0 );
+	for(int e = 0; e < m; ++e) {
+		++m_offsets[ m_head.at(e) + 1 ];
+		++m_offsets[ m_tail.at(e) + 1 ];
+	}
+	for(int i = 0; i < n; ++i)
+		m_offsets[i+1] += m_offsets.at(i);
+
+	m_neighbours = QVector<int>( 2 * m );
+	m_weights = QVector<qreal>( 2 * m );
+	m_edges = QVector<int>( 2 * m );
+	QVector<int> fill = m_offsets;
+	for(int e = 0; e < m; ++e) {
+		int h = m_head.at(e), t = m_tail.at(e);
+		int k = fill[h]++;
+		m_neighbours[k] = t;
+		m_weights[k] = m_weight.at(e);
+		m_edges[k] = e;
+		k = fill[t]++;
+		m_neighbours[k] = h;
+		m_weights[k] = m_weight.at(e);
+		m_edges[k] = e;
+	}
+	m_rowsValid = true;
+}
+
+int GraphCore::degree( int i ) const
+{
+	updateRows();
+	return m_offsets.at(i+1) - m_offsets.at(i);
+}
+
+const int* GraphCore::offsets() const
+{
+	updateRows();
+	return m_offsets.constData();
+}
+
+const int* GraphCore::neighbours() const
+{
+	updateRows();
+	return m_neighbours.constData();
+}
+
+const qreal* GraphCore::weights() const
+{
+	updateRows();
+	return m_weights.constData();
+}
+
+const int* GraphCore::edges() const
+{
+	updateRows();
+	return m_edges.constData();
+}
+
+DistanceMatrix::Adjacency GraphCore::adjacency() const
+{
+	updateRows();
+	int n = m_ids.size();
+	DistanceMatrix::Adjacency adjacency( n );
+	for(int i = 0; i < n; ++i) {
+		adjacency[i].reserve( m_offsets.at(i+1) - m_offsets.at(i) );
+		for(int k = m_offsets.at(i); k < m_offsets.at(i+1); ++k)
+			adjacency[i].append( qMakePair( m_neighbours.at(k),
+			                                m_weights.at(k) ) );
+	}
+	return adjacency;
+}
+
+quint64 GraphCore::topologyHash() const
+{
+	quint64 h = combine( m_ids.size(), m_head.size() );
+	for(int i = 0; i < m_ids.size(); ++i)
+		h = combine( h, m_ids.at(i) );
+	for(int e = 0; e < m_head.size(); ++e) {
+		quint64 weight;
+		memcpy( &weight, &m_weight.at(e), sizeof(weight) );
+		h = combine( h, ( (quint64)m_head.at(e) << 32 ) | m_tail.at(e) );
+		h = combine( h, weight );
+	}
+	return h;
+}
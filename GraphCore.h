@@ -0,0 +1,159 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef GRAPHCORE_H
+#define GRAPHCORE_H
+
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+
+#include "DistanceMatrix.h"
+#include "EdgeTable.h"
+
+/**
+ * @brief Compact storage of the topology and positions of a graph
+ *
+ * Vertices have dense indices 0 <= i < size() and edges dense indices
+ * 0 <= e < edgeCount(), both in the order they were added. Removing one
+ * moves the last one into the hole, so indices stay dense.
+ *
+ * Each undirected edge is stored once. Edges are found by the ids of their
+ * ends through an EdgeTable; if two edges join the same pair, the one
+ * with the highest index is found, and removing it lets the table find
+ * another. The table only depends on the edge list, so it can be built
+ * from it later.
+ * For walking the neighbours of a vertex there is a compressed sparse row
+ * view: the neighbours of i are neighbours()[offsets()[i]] up to
+ * neighbours()[offsets()[i+1]], with the weights and edge indices in the
+ * parallel arrays. It is rebuilt in O(n + m) on first use after the edges
+ * change.
+ *
+ * The positions are kept as separate x and y arrays, which is what the
+ * layouts sweep over.
+ */
+class GraphCore
+{
+public:
+	GraphCore();
+
+	/** @return the number of vertices */
+	int size() const;
+	/** @return the number of edges, each counted once */
+	int edgeCount() const;
+
+	/** Makes room for this many vertices and edges in all */
+	void reserve( int vertices, int edges );
+
+	/** @return the index of the new vertex */
+	int addVertex( uint id, qreal x, qreal y );
+	/**
+	 * Fills the empty core with @p n vertices and @p m edges straight from
+	 * arrays, as a file holds them, keeping their order. The ends must be
+	 * below @p n. Only the ids are hashed here, the rows and the table of
+	 * the edges are built on first use.
+	 * @return false if an id repeats
+	 */
+	bool assign( int n, const quint32 *ids, const double *x, const double *y,
+	             int m, const quint32 *heads, const quint32 *tails,
+	             const double *weights );
+	/**
+	 * Removes vertex @p i, which must not have any edges left. The last
+	 * vertex takes its index.
+	 * @return the old index of the vertex that moved to @p i, or -1 if
+	 * @p i was the last one
+	 */
+	int removeVertex( int i );
+
+	/** @return the index of the vertex with id @p id, -1 if there is none */
+	int index( uint id ) const;
+	/** @return the id of vertex @p i */
+	uint id( int i ) const;
+
+	qreal x( int i ) const;
+	qreal y( int i ) const;
+	void setPosition( int i, qreal x, qreal y );
+	/** @return the x coordinates of all vertices */
+	const QVector<qreal>& xs() const;
+	/** @return the y coordinates of all vertices */
+	const QVector<qreal>& ys() const;
+	/** Sets the positions of all vertices at once */
+	void setPositions( const QVector<qreal> &x, const QVector<qreal> &y );
+
+	/**
+	 * @return the index of the new edge between vertices @p head and
+	 * @p tail. Weights below 0.001, negative ones included, are raised to
+	 * that, so every distance is positive.
+	 */
+	int addEdge( int head, int tail, qreal weight );
+	/**
+	 * Removes edge @p e. The last edge takes its index.
+	 * @return the old index of the edge that moved to @p e, or -1 if @p e
+	 * was the last one
+	 */
+	int removeEdge( int e );
+
+	int head( int e ) const;
+	int tail( int e ) const;
+	qreal weight( int e ) const;
+	/** Sets the weight of edge @p e, raised to 0.001 like in addEdge() */
+	void setWeight( int e, qreal weight );
+
+	/** @return the edge between the vertices with ids @p a and @p b, or -1 */
+	int findEdge( uint a, uint b ) const;
+	/**
+	 * @return the weight of the edge between the vertices with ids @p a and
+	 * @p b, or @p missing if there is none
+	 */
+	qreal edgeWeight( uint a, uint b, qreal missing = 0.0 ) const;
+
+	/** @return the number of edges at vertex @p i */
+	int degree( int i ) const;
+	/** @return size() + 1 offsets into the neighbour arrays */
+	const int* offsets() const;
+	/** @return the neighbour at each end of every edge at every vertex */
+	const int* neighbours() const;
+	/** @return the weights parallel to neighbours() */
+	const qreal* weights() const;
+	/** @return the edge indices parallel to neighbours() */
+	const int* edges() const;
+
+	/** @return the neighbour lists in the form DistanceMatrix takes */
+	DistanceMatrix::Adjacency adjacency() const;
+	/**
+	 * @return a hash of the ids and of the ends and weights of the edges,
+	 * all in index order, to tell whether saved state still fits
+	 */
+	quint64 topologyHash() const;
+
+private:
+	void updateRows() const;
+	void updateTable() const;
+	/** @return another edge joining the ends of @p e, -1 if there is none */
+	int parallelEdge( int e ) const;
+
+	QVector<uint> m_ids;
+	QHash<uint,int> m_index;
+	QVector<qreal> m_x;
+	QVector<qreal> m_y;
+
+	QVector<int> m_head;
+	QVector<int> m_tail;
+	QVector<qreal> m_weight;
+	/// built from the edge list on demand after assign()
+	mutable EdgeTable m_table;
+	mutable bool m_tableValid;
+
+	/// the compressed sparse rows, built from the edge list on demand
+	mutable QVector<int> m_offsets;
+	mutable QVector<int> m_neighbours;
+	mutable QVector<qreal> m_weights;
+	mutable QVector<int> m_edges;
+	mutable bool m_rowsValid;
+};
+
+#endif //include guard
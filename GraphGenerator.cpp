@@ -0,0 +1,118 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "GraphGenerator.h"
+
+#include "EdgeTable.h"
+#include "GraphBuilder.h"
+#include "GraphCore.h"
+#include "RandomGenerator.h"
+
+GraphGenerator::GraphGenerator( RandomGenerator *random )
+{
+	m_random = random;
+}
+
+void GraphGenerator::addRandomEdges( int first, int n, int count,
+                                     EdgeTable *seen, EdgeList *edges )
+{
+	//a complete graph is as far as it goes
+	count = (int)qMin( (qint64)count, (qint64)n * ( n - 1 ) / 2 );
+	int added = 0;
+	while( added < count ) {
+		int i = first + m_random->below( n );
+		int j = first + m_random->below( n );
+		if( i == j || seen->edge( i, j ) >= 0 )
+			continue;
+		seen->insert( i, j, edges->size(), 1.0 );
+		edges->append( qMakePair( i, j ) );
+		++added;
+	}
+}
+
+GraphGenerator::EdgeList GraphGenerator::erdosRenyi( int n, qreal degree )
+{
+	EdgeList edges;
+	EdgeTable seen;
+	addRandomEdges( 0, n, (int)( n * degree / 2 ), &seen, &edges );
+	return edges;
+}
+
+GraphGenerator::EdgeList GraphGenerator::barabasiAlbert( int n, int links )
+{
+	EdgeList edges;
+	links = qMax( 1, qMin( links, n - 1 ) );
+	//every vertex is in here once per edge, so a uniform pick from it is
+	//proportional to the degree
+	QVector<int> ends;
+	//the first links + 1 vertices start out fully connected
+	int start = qMin( n, links + 1 );
+	for(int i = 0; i < start; ++i)
+		for(int j = 0; j < i; ++j) {
+			edges.append( qMakePair( i, j ) );
+			ends.append( i );
+			ends.append( j );
+		}
+	QVector<int> targets;
+	for(int i = start; i < n; ++i) {
+		targets.clear();
+		while( targets.size() < links ) {
+			int j = ends.at( m_random->below( ends.size() ) );
+			if( !targets.contains( j ) )
+				targets.append( j );
+		}
+		for(int t = 0; t < targets.size(); ++t) {
+			edges.append( qMakePair( i, targets.at(t) ) );
+			ends.append( i );
+			ends.append( targets.at(t) );
+		}
+	}
+	return edges;
+}
+
+GraphGenerator::EdgeList GraphGenerator::grid( int width, int height )
+{
+	EdgeList edges;
+	for(int r = 0; r < height; ++r)
+		for(int c = 0; c < width; ++c) {
+			int i = r * width + c;
+			if( c + 1 < width )
+				edges.append( qMakePair( i, i + 1 ) );
+			if( r + 1 < height )
+				edges.append( qMakePair( i, i + width ) );
+		}
+	return edges;
+}
+
+GraphGenerator::EdgeList GraphGenerator::clusters( int n, int count,
+                                                   qreal degree )
+{
+	EdgeList edges;
+	EdgeTable seen;
+	count = qMax( 1, qMin( count, n ) );
+	for(int c = 0; c < count; ++c) {
+		int first = (int)( (qint64)n * c / count );
+		int size = (int)( (qint64)n * ( c + 1 ) / count ) - first;
+		addRandomEdges( first, size, (int)( size * degree / 2 ), &seen,
+		                &edges );
+	}
+	return edges;
+}
+
+void GraphGenerator::fill( GraphCore *core, QVector<QString> *labels, int n,
+                           const EdgeList &edges )
+{
+	Q_ASSERT( core->size() == 0 );
+	GraphBuilder builder;
+	builder.reserve( n, edges.size() );
+	//the new ids count up from 1
+	builder.addVertices( n );
+	builder.addEdges( edges );
+	builder.build( core, labels );
+}
@@ -0,0 +1,68 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef GRAPHGENERATOR_H
+#define GRAPHGENERATOR_H
+
+#include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class EdgeTable;
+class GraphCore;
+class RandomGenerator;
+
+/**
+ * @brief Makes synthetic graphs to measure the layouts on
+ *
+ * The generators return the edges as pairs of vertex indices 0 <= i < n,
+ * without loops or repeated edges. fill() turns them into a GraphCore.
+ */
+class GraphGenerator
+{
+public:
+	typedef QVector<QPair<int,int> > EdgeList;
+
+	/** @param random the source of the random graphs */
+	GraphGenerator( RandomGenerator *random );
+
+	/**
+	 * @return a graph with @p n vertices and n * @p degree / 2 edges, each
+	 * joining a uniformly chosen pair
+	 */
+	EdgeList erdosRenyi( int n, qreal degree );
+	/**
+	 * @return a graph grown by preferential attachment: each new vertex
+	 * joins @p links vertices chosen with a probability proportional to
+	 * their degree, which gives a few hubs like a network of friends
+	 */
+	EdgeList barabasiAlbert( int n, int links );
+	/** @return a @p width by @p height grid, indexed row by row */
+	EdgeList grid( int width, int height );
+	/**
+	 * @return @p count disconnected Erdős–Rényi graphs of about
+	 * @p n / @p count vertices each
+	 */
+	EdgeList clusters( int n, int count, qreal degree );
+
+	/**
+	 * Adds @p n vertices with ids 1 to @p n at the origin and @p edges to
+	 * the empty @p core, and the ids as labels to @p labels
+	 */
+	static void fill( GraphCore *core, QVector<QString> *labels, int n,
+	                  const EdgeList &edges );
+
+private:
+	/** adds @p count random edges among the vertices first to first + n - 1 */
+	void addRandomEdges( int first, int n, int count, EdgeTable *seen,
+	                     EdgeList *edges );
+
+	RandomGenerator *m_random;
+};
+
+#endif //include guard
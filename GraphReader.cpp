@@ -0,0 +1,469 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "GraphReader.h"
+
+// C
+#include <climits>
+#include <cstring>
+
+// QtCore
+#include <QtCore/QFile>
+#include <QtCore/QIODevice>
+#include <QtCore/QTextStream>
+
+#include "GraphBuilder.h"
+#include "GraphCore.h"
+#include "WorkerPool.h"
+
+// the size of the chunks read when a file can't be mapped
+static const int CHUNKSIZE = 1 << 20;
+// a mapped file is handed to the WorkerPool in blocks of this many bytes,
+// so a part is at least a thousand blocks
+static const int BLOCKSIZE = 1024;
+// the number of error messages kept, the rest are only counted
+static const int MAXERRORS = 100;
+
+static inline bool isSpace( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f'
+	       || c == '\v';
+}
+
+static inline bool isDigit( char c )
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline const char* skipSpace( const char *p, const char *end )
+{
+	while( p < end && isSpace(*p) )
+		++p;
+	return p;
+}
+
+/* @return the position after @p literal, 0 if the text doesn't start with it */
+static inline const char* expect( const char *p, const char *end,
+                                  const char *literal )
+{
+	for(; *literal; ++literal, ++p)
+		if( p == end || *p != *literal )
+			return 0;
+	return p;
+}
+
+/* @return the position after the number, 0 if there is none or it's too big */
+static const char* parseUInt( const char *p, const char *end, uint *value )
+{
+	if( p == end || !isDigit(*p) )
+		return 0;
+	quint64 v = 0;
+	for(; p < end && isDigit(*p); ++p) {
+		v = v * 10 + ( *p - '0' );
+		if( v > 0xffffffffu )
+			return 0;
+	}
+	*value = (uint)v;
+	return p;
+}
+
+/* Reads [+-]digits[.digits][(e|E)[+-]digits] without going through the C
+ * locale. Up to 19 significant digits are kept in an integer; while that
+ * and the power of ten are exact doubles, the result is rounded correctly.
+ * @return the position after the number, 0 if there is none */
+static const char* parseReal( const char *p, const char *end, qreal *value )
+{
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+		1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+		1e20, 1e21, 1e22 };
+
+	bool negative = false;
+	if( p < end && ( *p == '-' || *p == '+' ) ) {
+		negative = *p == '-';
+		++p;
+	}
+	quint64 mantissa = 0;
+	int significant = 0;
+	int exponent = 0;
+	bool digits = false;
+	for(; p < end && isDigit(*p); ++p) {
+		digits = true;
+		if( significant < 19 ) {
+			mantissa = mantissa * 10 + ( *p - '0' );
+			if( mantissa )
+				++significant;
+		} else {
+			++exponent;
+		}
+	}
+	if( p < end && *p == '.' ) {
+		for(++p; p < end && isDigit(*p); ++p) {
+			digits = true;
+			if( significant < 19 ) {
+				mantissa = mantissa * 10 + ( *p - '0' );
+				if( mantissa )
+					++significant;
+				--exponent;
+			}
+		}
+	}
+	if( !digits )
+		return 0;
+	if( p < end && ( *p == 'e' || *p == 'E' ) ) {
+		const char *q = p + 1;
+		bool negativeExponent = false;
+		if( q < end && ( *q == '-' || *q == '+' ) ) {
+			negativeExponent = *q == '-';
+			++q;
+		}
+		if( q < end && isDigit(*q) ) {
+			int e = 0;
+			for(; q < end && isDigit(*q); ++q)
+				if( e < 10000 )
+					e = e * 10 + ( *q - '0' );
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+	}
+
+	double v = (double)mantissa;
+	if( mantissa ) {
+		while( exponent > 22 ) {
+			v *= 1e22;
+			exponent -= 22;
+		}
+		while( exponent < -22 ) {
+			v /= 1e22;
+			exponent += 22;
+		}
+		v = exponent < 0 ? v / powers[-exponent] : v * powers[exponent];
+	}
+	*value = negative ? -v : v;
+	return p;
+}
+
+/* @return the offset of the first line that starts at or after @p offset */
+static qint64 lineStart( const char *text, qint64 size, qint64 offset )
+{
+	if( offset <= 0 )
+		return 0;
+	if( offset >= size )
+		return size;
+	const char *newline = (const char*)memchr( text + offset - 1, '\n',
+	                                           size - offset + 1 );
+	return newline ? newline + 1 - text : size;
+}
+
+GraphReader::GraphReader()
+{
+	m_line = 0;
+	m_errorCount = 0;
+	m_text = 0;
+	m_textSize = 0;
+	m_pieces = 0;
+}
+
+bool GraphReader::readFile( const QString &fileName, WorkerPool *pool )
+{
+	QFile file( fileName );
+	if( !file.open( QIODevice::ReadOnly ) ) {
+		error( 0, fileName + ": " + file.errorString() );
+		return false;
+	}
+	uchar *data = file.size() > 0 ? file.map( 0, file.size() ) : 0;
+	if( data ) {
+		const char *begin = reinterpret_cast<const char*>( data );
+		qint64 blocks = ( file.size() + BLOCKSIZE - 1 ) / BLOCKSIZE;
+		int parts = pool ? pool->parts( (int)qMin( blocks, (qint64)INT_MAX ) )
+		                 : 1;
+		if( parts > 1 && blocks <= INT_MAX ) {
+			QVector<GraphReader> pieces( parts );
+			m_text = begin;
+			m_textSize = file.size();
+			m_pieces = pieces.data();
+			ParallelMemberTask<GraphReader> task( this,
+			                                      &GraphReader::parseBlocks );
+			pool->run( &task, (int)blocks );
+			m_text = 0;
+			m_pieces = 0;
+			for(int part = 0; part < parts; ++part)
+				append( pieces.at(part) );
+		} else {
+			parse( begin, begin + file.size() );
+		}
+		file.unmap( data );
+	} else {
+		read( &file );
+	}
+	return true;
+}
+
+/* A piece holds the lines that start in its blocks */
+void GraphReader::parseBlocks( int part, int begin, int end )
+{
+	qint64 first = lineStart( m_text, m_textSize, (qint64)begin * BLOCKSIZE );
+	qint64 last = lineStart( m_text, m_textSize, (qint64)end * BLOCKSIZE );
+	m_pieces[part].parse( m_text + first, m_text + last );
+}
+
+void GraphReader::append( const GraphReader &other )
+{
+	int labels = m_labels.size();
+	m_vertices.reserve( m_vertices.size() + other.m_vertices.size() );
+	for(int i = 0; i < other.m_vertices.size(); ++i) {
+		VertexRecord v = other.m_vertices.at(i);
+		v.line += m_line;
+		v.label += labels;
+		m_vertices.append( v );
+	}
+	m_edges.reserve( m_edges.size() + other.m_edges.size() );
+	for(int i = 0; i < other.m_edges.size(); ++i) {
+		EdgeRecord e = other.m_edges.at(i);
+		e.line += m_line;
+		m_edges.append( e );
+	}
+	m_labels.append( other.m_labels );
+	for(int i = 0; i < other.m_errors.size(); ++i)
+		if( m_errors.size() < MAXERRORS ) {
+			Error e = other.m_errors.at(i);
+			e.line += m_line;
+			m_errors.append( e );
+		}
+	m_errorCount += other.m_errorCount;
+	m_line += other.m_line;
+}
+
+void GraphReader::read( QIODevice *device )
+{
+	QByteArray chunk( CHUNKSIZE, '\0' );
+	qint64 size;
+	while( ( size = device->read( chunk.data(), CHUNKSIZE ) ) > 0 )
+		feed( chunk.constData(), chunk.constData() + size );
+	finish();
+}
+
+void GraphReader::read( QTextStream *stream )
+{
+	while( !stream->atEnd() ) {
+		QByteArray chunk = stream->read( CHUNKSIZE ).toUtf8();
+		feed( chunk.constData(), chunk.constData() + chunk.size() );
+	}
+	finish();
+}
+
+/* Parses the whole lines of a chunk and keeps the rest for the next one */
+void GraphReader::feed( const char *begin, const char *end )
+{
+	const char *last = end;
+	while( last > begin && last[-1] != '\n' )
+		--last;
+	if( last == begin ) {
+		m_pending.append( begin, end - begin );
+		return;
+	}
+	if( !m_pending.isEmpty() ) {
+		const char *newline = (const char*)memchr( begin, '\n', end - begin );
+		m_pending.append( begin, newline + 1 - begin );
+		parse( m_pending.constData(), m_pending.constData() + m_pending.size() );
+		m_pending.clear();
+		begin = newline + 1;
+	}
+	parse( begin, last );
+	m_pending.append( last, end - last );
+}
+
+void GraphReader::finish()
+{
+	parse( m_pending.constData(), m_pending.constData() + m_pending.size() );
+	m_pending.clear();
+}
+
+void GraphReader::parse( const char *begin, const char *end )
+{
+	while( begin < end ) {
+		const char *newline = (const char*)memchr( begin, '\n', end - begin );
+		const char *lineEnd = newline ? newline : end;
+		++m_line;
+		parseLine( begin, lineEnd );
+		begin = newline ? newline + 1 : end;
+	}
+}
+
+void GraphReader::parseLine( const char *begin, const char *end )
+{
+	const char *p = skipSpace( begin, end );
+	//like before, anything that doesn't start with an id is not a statement
+	if( p == end || !isDigit(*p) )
+		return;
+
+	uint id;
+	p = parseUInt( p, end, &id );
+	if( !p ) {
+		error( m_line, "id out of range" );
+		return;
+	}
+	const char *q = skipSpace( p, end );
+	const char *message;
+	if( q < end && *q == '[' && q != p )
+		message = parseVertex( id, q, end );
+	else if( expect( q, end, "--" ) )
+		message = parseEdge( id, skipSpace( q + 2, end ), end );
+	else
+		message = "expected [label=... or --";
+	if( message )
+		error( m_line, message );
+}
+
+/* UID [label="LABELTEXT",pos="X Y"] with anything after it. The label runs
+ * to the last ",pos=" on the line, \" in it stands for ".
+ * @return 0, or what is wrong with the statement */
+const char* GraphReader::parseVertex( uint id, const char *p, const char *end )
+{
+	static const char separator[] = "\",pos=\"";
+	static const int separatorSize = sizeof(separator) - 1;
+
+	p = expect( p, end, "[label=\"" );
+	if( !p )
+		return "expected [label=\"";
+	if( end - p < separatorSize )
+		return "expected \",pos=\"";
+	const char *labelEnd = end - separatorSize;
+	while( labelEnd >= p && memcmp( labelEnd, separator, separatorSize ) != 0 )
+		--labelEnd;
+	if( labelEnd < p )
+		return "expected \",pos=\"";
+
+	VertexRecord v;
+	v.id = id;
+	v.line = m_line;
+	const char *q = labelEnd + separatorSize;
+	q = parseReal( q, end, &v.x );
+	if( !q || q == end || !isSpace(*q) )
+		return "expected the x and y coordinates";
+	q = parseReal( skipSpace( q, end ), end, &v.y );
+	if( !q )
+		return "expected the y coordinate";
+	if( !expect( q, end, "\"]" ) )
+		return "expected \"] after the position";
+
+	v.label = m_labels.size();
+	for(const char *c = p; c < labelEnd; ++c) {
+		if( *c == '\\' && c + 1 < labelEnd && c[1] == '"' )
+			++c;
+		m_labels.append( *c );
+	}
+	v.labelSize = m_labels.size() - v.label;
+	m_vertices.append( v );
+	return 0;
+}
+
+/* UID -- UID2 [weight="W"] with anything after it, p is after the --
+ * @return 0, or what is wrong with the statement */
+const char* GraphReader::parseEdge( uint head, const char *p, const char *end )
+{
+	EdgeRecord e;
+	e.head = head;
+	e.line = m_line;
+	p = parseUInt( p, end, &e.tail );
+	if( !p )
+		return "expected the id of the tail";
+	p = expect( skipSpace( p, end ), end, "[weight=\"" );
+	if( !p )
+		return "expected [weight=\"";
+	p = parseReal( p, end, &e.weight );
+	if( !p )
+		return "expected the weight";
+	if( !expect( p, end, "\"]" ) )
+		return "expected \"] after the weight";
+	//a weight is a length, the old format only had unsigned ones
+	if( !( e.weight > 0.0 ) )
+		return "the weight must be positive";
+	m_edges.append( e );
+	return 0;
+}
+
+void GraphReader::build( GraphCore *core, QVector<QString> *labels )
+{
+	GraphBuilder builder;
+	builder.reserve( m_vertices.size(), m_edges.size() );
+	//edges name their ends by the ids in the file, 0 included
+	builder.setNewIds( false );
+	for(int i = 0; i < m_vertices.size(); ++i) {
+		const VertexRecord &v = m_vertices.at(i);
+		builder.addVertex( v.id, v.x, v.y, label(v) );
+	}
+	//older files list every edge in both directions, the builder keeps one
+	for(int i = 0; i < m_edges.size(); ++i) {
+		const EdgeRecord &e = m_edges.at(i);
+		builder.addEdgeById( e.head, e.tail, e.weight );
+	}
+	builder.build( core, labels );
+
+	const QVector<int> &duplicates = builder.duplicateVertices();
+	for(int d = 0; d < duplicates.size(); ++d) {
+		const VertexRecord &v = m_vertices.at( duplicates.at(d) );
+		error( v.line, QString("id %1 is already used").arg( v.id ) );
+	}
+	const QVector<int> &dangling = builder.danglingEdges();
+	for(int d = 0; d < dangling.size(); ++d) {
+		const EdgeRecord &e = m_edges.at( dangling.at(d) );
+		error( e.line, QString("id %1 not found")
+		                      .arg( core->index( e.head ) < 0 ? e.head
+		                                                      : e.tail ) );
+	}
+}
+
+int GraphReader::lines() const
+{
+	return m_line;
+}
+
+const QVector<GraphReader::VertexRecord>& GraphReader::vertices() const
+{
+	return m_vertices;
+}
+
+const QVector<GraphReader::EdgeRecord>& GraphReader::edges() const
+{
+	return m_edges;
+}
+
+QString GraphReader::label( const VertexRecord &v ) const
+{
+	return QString::fromUtf8( m_labels.constData() + v.label, v.labelSize );
+}
+
+int GraphReader::errorCount() const
+{
+	return m_errorCount;
+}
+
+QStringList GraphReader::errors() const
+{
+	QStringList errors;
+	for(int i = 0; i < m_errors.size(); ++i) {
+		const Error &e = m_errors.at(i);
+		if( e.line > 0 )
+			errors.append( QString("line %1: %2").arg( e.line ).arg( e.message ) );
+		else
+			errors.append( e.message );
+	}
+	return errors;
+}
+
+void GraphReader::error( int line, const QString &message )
+{
+	++m_errorCount;
+	if( m_errors.size() >= MAXERRORS )
+		return;
+	Error e;
+	e.line = line;
+	e.message = message;
+	m_errors.append( e );
+}
@@ -0,0 +1,130 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef GRAPHREADER_H
+#define GRAPHREADER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+class GraphCore;
+class QIODevice;
+class QTextStream;
+class WorkerPool;
+
+/**
+ * @brief Parses the DOT based format of Graph::readGraph
+ *
+ * The text is split into lines and tokenized in place with pointers, the
+ * numbers are converted by hand, so the only allocations are the growth of
+ * the record arrays and of one buffer holding all labels. Files are
+ * memory-mapped where possible and read in large chunks otherwise. A
+ * mapped file can also be cut into pieces at line boundaries which are
+ * parsed on the threads of a WorkerPool into separate buffers, and joined
+ * in file order afterwards.
+ *
+ * Reading only collects the statements. build() then adds all vertices
+ * before any edge, so an edge may come before the vertices it joins.
+ * Lines which don't start with an id are skipped, as before; a statement
+ * that doesn't parse, an edge weight that isn't positive, an unknown id
+ * or a repeated vertex id is reported with its line number in errors()
+ * and left out.
+ */
+class GraphReader
+{
+public:
+	/// a vertex statement
+	struct VertexRecord {
+		uint id;
+		qreal x, y;
+		int label; ///< the offset of the label in labels()
+		int labelSize;
+		int line;
+	};
+	/// an edge statement
+	struct EdgeRecord {
+		uint head, tail;
+		qreal weight;
+		int line;
+	};
+
+	GraphReader();
+
+	/**
+	 * Reads the file @p fileName, memory-mapped if the platform allows
+	 * @param pool the threads that parse pieces of a mapped file, 0 to
+	 * parse it on the calling thread
+	 * @return false if the file can't be opened
+	 */
+	bool readFile( const QString &fileName, WorkerPool *pool = 0 );
+	/** Reads @p device to its end in large chunks */
+	void read( QIODevice *device );
+	/** Reads @p stream to its end in large chunks */
+	void read( QTextStream *stream );
+	/**
+	 * Parses the lines in @p begin to @p end. Each call continues with the
+	 * line numbers where the last one left off; the text must not end in
+	 * the middle of a line unless it is the last call.
+	 */
+	void parse( const char *begin, const char *end );
+
+	/**
+	 * Adds the statements read so far to @p core, and the label of each
+	 * vertex it adds to @p labels, through a GraphBuilder. The ids are
+	 * kept as they are in the file, 0 included. Graph::fromCore() makes a
+	 * graph of them.
+	 */
+	void build( GraphCore *core, QVector<QString> *labels );
+
+	/** @return the number of lines read */
+	int lines() const;
+	const QVector<VertexRecord>& vertices() const;
+	const QVector<EdgeRecord>& edges() const;
+	/** @return the label of @p v */
+	QString label( const VertexRecord &v ) const;
+
+	/** @return the number of errors found */
+	int errorCount() const;
+	/** @return the first errors found, each starting with the line number */
+	QStringList errors() const;
+
+private:
+	struct Error {
+		int line; ///< 0 if it is not about a line
+		QString message;
+	};
+
+	/** Parses the pieces of a mapped file for the parts of a WorkerPool */
+	void parseBlocks( int part, int begin, int end );
+	/** Appends what @p other read, as if it followed what was read so far */
+	void append( const GraphReader &other );
+	void feed( const char *begin, const char *end );
+	void finish();
+	void parseLine( const char *begin, const char *end );
+	const char* parseVertex( uint id, const char *p, const char *end );
+	const char* parseEdge( uint head, const char *p, const char *end );
+	void error( int line, const QString &message );
+
+	QVector<VertexRecord> m_vertices;
+	QVector<EdgeRecord> m_edges;
+	QByteArray m_labels;
+	/// the start of a line cut off at the end of the last chunk
+	QByteArray m_pending;
+	int m_line;
+	QVector<Error> m_errors;
+	int m_errorCount;
+
+	/// the mapped file and one reader per piece while parsing in parallel
+	const char *m_text;
+	qint64 m_textSize;
+	GraphReader *m_pieces;
+};
+
+#endif //include guard
@@ -0,0 +1,307 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "GraphViewport.h"
+
+#include <climits>
+
+// QtCore
+#include <QtCore/QEvent>
+#include <QtCore/QTimerEvent>
+
+// QtGui
+#include <QtGui/QBrush>
+#include <QtGui/QColor>
+#include <QtGui/QGraphicsRectItem>
+#include <QtGui/QGraphicsScene>
+#include <QtGui/QGraphicsView>
+#include <QtGui/QPainter>
+#include <QtGui/QPen>
+#include <QtGui/QPolygonF>
+#include <QtGui/QStyleOptionGraphicsItem>
+#include <QtGui/QWidget>
+
+#include "Graph.h"
+#include "GraphCore.h"
+#include "Vertex.h"
+
+// the items cover this much of the view's size again on every side
+static const qreal MARGIN = 0.5;
+// the items are remade once the view is this many times smaller than them
+static const qreal ZOOMIN = 16.0;
+
+/* A pooled item that draws one vertex like a Vertex item does */
+class VertexSprite : public QGraphicsRectItem
+{
+public:
+	VertexSprite() : m_vertex( -1 ) { setZValue( 2.0 ); }
+
+	/** @return the vertex shown, -1 if the item is in the pool */
+	int vertex() const { return m_vertex; }
+	void assign( int vertex, const QString &text )
+	{
+		m_vertex = vertex;
+		m_text = text;
+		m_size = Vertex::boxSize( text );
+		show();
+	}
+	void place( qreal x, qreal y )
+	{
+		setRect( QRectF( x - m_size.width()/2, y - m_size.height()/2,
+		                 m_size.width(), m_size.height() ) );
+	}
+	void release()
+	{
+		m_vertex = -1;
+		m_text = QString();
+		hide();
+	}
+
+	void paint( QPainter *painter, const QStyleOptionGraphicsItem *option,
+	            QWidget *widget = 0 )
+	{
+		Q_UNUSED( option );
+		Q_UNUSED( widget );
+		Vertex::paintBox( painter, rect(), m_text );
+	}
+
+private:
+	int m_vertex;
+	QString m_text;
+	QSizeF m_size;
+};
+
+/* Draws every vertex in the exposed rect as a dot, for when there are
+ * too many to have items. The vertices are found with the tree of the
+ * viewport, which is rebuilt whenever they move. */
+class VertexDots : public QGraphicsItem
+{
+public:
+	VertexDots( const Graph *g, const QuadTree *tree )
+	    : m_graph( g ), m_tree( tree )
+	{
+		setFlag( QGraphicsItem::ItemUsesExtendedStyleOption );
+		setZValue( 2.0 );
+	}
+
+	void setBounds( const QRectF &bounds )
+	{
+		if( bounds == m_bounds )
+			return;
+		prepareGeometryChange();
+		m_bounds = bounds;
+	}
+	QRectF boundingRect() const { return m_bounds; }
+
+	void paint( QPainter *painter, const QStyleOptionGraphicsItem *option,
+	            QWidget *widget = 0 )
+	{
+		Q_UNUSED( widget );
+		const GraphCore *core = m_graph->core();
+		m_found.resize( 0 );
+		m_tree->points( option->exposedRect, INT_MAX, &m_found );
+		m_points.resize( m_found.size() );
+		for(int j = 0; j < m_found.size(); ++j) {
+			int i = m_found.at(j);
+			m_points[j] = QPointF( core->x(i), core->y(i) );
+		}
+		if( m_points.isEmpty() )
+			return;
+		//one pixel, whatever the zoom
+		QPen pen( QColor( Qt::black ) );
+		pen.setWidthF( 0.0 );
+		painter->setPen( pen );
+		painter->drawPoints( m_points.constData(), m_points.size() );
+	}
+
+private:
+	const Graph *m_graph;
+	const QuadTree *m_tree;
+	QRectF m_bounds;
+	/// the vertices and dots of the last paint, kept to reuse the memory
+	QVector<int> m_found;
+	QVector<QPointF> m_points;
+};
+
+GraphViewport::GraphViewport( Graph *g, QGraphicsView *view, QObject *parent )
+    : QObject( parent )
+{
+	Q_ASSERT( g->isHeadless() );
+	m_graph = g;
+	m_view = view;
+	m_moved = true;
+	m_limit = 5000;
+	m_timer = 0;
+	m_generation = 0;
+	m_slot = QVector<int>( g->core()->size(), -1 );
+	m_stamp = QVector<int>( g->core()->size(), 0 );
+	m_dots = new VertexDots( g, &m_tree );
+	m_dots->hide();
+	m_view->scene()->addItem( m_dots );
+
+	m_graph->setViewport( this );
+	m_view->viewport()->installEventFilter( this );
+	scheduleRefresh();
+}
+
+GraphViewport::~GraphViewport()
+{
+	m_view->viewport()->removeEventFilter( this );
+	if( m_graph->viewport() == this )
+		m_graph->setViewport( 0 );
+	//an item takes itself out of its scene
+	for(int k = 0; k < m_items.size(); ++k)
+		delete m_items.at(k);
+	delete m_dots;
+}
+
+int GraphViewport::itemLimit() const
+{
+	return m_limit;
+}
+
+void GraphViewport::setItemLimit( int limit )
+{
+	m_limit = qMax( 0, limit );
+	m_region = QRectF();
+	scheduleRefresh();
+}
+
+int GraphViewport::itemCount() const
+{
+	return m_items.size() - m_free.size();
+}
+
+void GraphViewport::positionsChanged()
+{
+	m_moved = true;
+	scheduleRefresh();
+}
+
+bool GraphViewport::eventFilter( QObject *watched, QEvent *event )
+{
+	//scrolling and zooming both repaint the viewport
+	if( ( event->type() == QEvent::Paint || event->type() == QEvent::Resize )
+	    && isStale() )
+		scheduleRefresh();
+	return QObject::eventFilter( watched, event );
+}
+
+void GraphViewport::timerEvent( QTimerEvent *event )
+{
+	if( event->timerId() != m_timer ) {
+		QObject::timerEvent( event );
+		return;
+	}
+	killTimer( m_timer );
+	m_timer = 0;
+	refresh();
+}
+
+QRectF GraphViewport::visibleRect() const
+{
+	return m_view->mapToScene( m_view->viewport()->rect() ).boundingRect();
+}
+
+bool GraphViewport::isStale() const
+{
+	QRectF visible = visibleRect();
+	if( !m_region.contains( visible ) )
+		return true;
+	return visible.width() * visible.height() * ZOOMIN
+	       < m_region.width() * m_region.height();
+}
+
+/* The items are changed from a timer rather than the paint event, which
+ * would otherwise change the scene it is painting */
+void GraphViewport::scheduleRefresh()
+{
+	if( !m_timer )
+		m_timer = startTimer( 0 );
+}
+
+void GraphViewport::refresh()
+{
+	const GraphCore *core = m_graph->core();
+	if( m_moved ) {
+		m_tree.build( core->xs().constData(), core->ys().constData(),
+		              core->size() );
+		QRectF bounds = vertexBounds();
+		m_dots->setBounds( bounds );
+		//the dots were drawn from the old tree
+		m_dots->update();
+		m_view->scene()->setSceneRect( bounds );
+	}
+
+	QRectF visible = visibleRect();
+	m_region = visible.adjusted( -visible.width() * MARGIN,
+	                             -visible.height() * MARGIN,
+	                             visible.width() * MARGIN,
+	                             visible.height() * MARGIN );
+	m_inside.resize( 0 );
+	bool fits = m_tree.points( m_region, m_limit, &m_inside );
+	if( !fits )
+		m_inside.resize( 0 );
+	m_dots->setVisible( !fits );
+
+	++m_generation;
+	for(int j = 0; j < m_inside.size(); ++j)
+		m_stamp[m_inside.at(j)] = m_generation;
+	//back to the pool with the ones left behind, the others may have moved
+	for(int k = 0; k < m_items.size(); ++k) {
+		VertexSprite *item = m_items.at(k);
+		int i = item->vertex();
+		if( i < 0 )
+			continue;
+		if( m_stamp.at(i) != m_generation ) {
+			m_slot[i] = -1;
+			item->release();
+			m_free.append( k );
+		} else if( m_moved )
+			item->place( core->x(i), core->y(i) );
+	}
+
+	QVector<QString> labels = m_graph->labels();
+	for(int j = 0; j < m_inside.size(); ++j) {
+		int i = m_inside.at(j);
+		if( m_slot.at(i) >= 0 )
+			continue;
+		int k;
+		if( m_free.isEmpty() ) {
+			k = m_items.size();
+			m_items.append( new VertexSprite() );
+			m_view->scene()->addItem( m_items.last() );
+		} else {
+			k = m_free.last();
+			m_free.remove( m_free.size() - 1 );
+		}
+		m_items.at(k)->assign( i, labels.at(i) );
+		m_items.at(k)->place( core->x(i), core->y(i) );
+		m_slot[i] = k;
+	}
+	m_moved = false;
+}
+
+QRectF GraphViewport::vertexBounds() const
+{
+	const GraphCore *core = m_graph->core();
+	if( core->size() == 0 )
+		return QRectF();
+	qreal left = core->x(0), right = left;
+	qreal top = core->y(0), bottom = top;
+	for(int i = 1; i < core->size(); ++i) {
+		left = qMin( left, core->x(i) );
+		right = qMax( right, core->x(i) );
+		top = qMin( top, core->y(i) );
+		bottom = qMax( bottom, core->y(i) );
+	}
+	//room for the boxes of the vertices on the border
+	return QRectF( left, top, right - left, bottom - top )
+	       .adjusted( -50.0, -50.0, 50.0, 50.0 );
+}
@@ -0,0 +1,105 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef GRAPHVIEWPORT_H
+#define GRAPHVIEWPORT_H
+
+#include <QtCore/QObject>
+#include <QtCore/QRectF>
+#include <QtCore/QVector>
+
+#include "QuadTree.h"
+
+class QEvent;
+class QGraphicsView;
+class QTimerEvent;
+
+class Graph;
+class VertexDots;
+class VertexSprite;
+
+/**
+ * @brief Shows a headless graph with items for the visible vertices only
+ *
+ * A Graph with a Vertex item for every vertex pays for a QGraphicsItem
+ * and a scene index entry per vertex, which is too much for a million of
+ * them. This shows a headless graph, whose vertices are only the arrays
+ * of its GraphCore, in a view. The vertices in and around the visible
+ * part of the scene are found with a QuadTree and get items from a pool;
+ * items of vertices that scroll out of sight go back to the pool.
+ *
+ * When more than itemLimit() vertices would need an item, which happens
+ * when zoomed far out, all vertices are drawn as dots by one item instead.
+ * Put an EdgeLayer in the scene for the edges.
+ *
+ * The viewport watches the paint events of the view, so scrolling and
+ * zooming need nothing else. Layouts tell it through Graph::updateItems()
+ * when the vertices move.
+ */
+class GraphViewport : public QObject
+{
+public:
+	/**
+	 * Shows @p g in the scene of @p view, and becomes the viewport of the
+	 * graph
+	 * @param g a headless graph
+	 */
+	GraphViewport( Graph *g, QGraphicsView *view, QObject *parent = 0 );
+	/** Deletes the items */
+	~GraphViewport();
+
+	/** @return the most vertex items shown at once */
+	int itemLimit() const;
+	/** Sets the most vertex items shown at once, 5000 by default */
+	void setItemLimit( int limit );
+	/** @return the number of vertices shown as items now */
+	int itemCount() const;
+
+	/** Called by the graph after vertices have moved */
+	void positionsChanged();
+
+	bool eventFilter( QObject *watched, QEvent *event );
+
+protected:
+	void timerEvent( QTimerEvent *event );
+
+private:
+	/** @return the part of the scene the view shows */
+	QRectF visibleRect() const;
+	/** @return true if the items don't cover the view well any more */
+	bool isStale() const;
+	void scheduleRefresh();
+	/** fills the region around the view with items */
+	void refresh();
+	/** @return the bounds of all vertices */
+	QRectF vertexBounds() const;
+
+	Graph *m_graph;
+	QGraphicsView *m_view;
+	QuadTree m_tree;
+	/// the vertices have moved since the tree was built
+	bool m_moved;
+	/// the part of the scene the items were made for
+	QRectF m_region;
+	int m_limit;
+	int m_timer;
+
+	/// every item made so far, in use or not
+	QVector<VertexSprite*> m_items;
+	/// the indices in m_items of the ones not in use
+	QVector<int> m_free;
+	/// the item of each vertex, -1 for none
+	QVector<int> m_slot;
+	/// the refresh a vertex was last found in
+	QVector<int> m_stamp;
+	int m_generation;
+	QVector<int> m_inside;
+	VertexDots *m_dots;
+};
+
+#endif //include guard
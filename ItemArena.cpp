@@ -0,0 +1,91 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "ItemArena.h"
+
+// C++ std lib for operator new
+#include <new>
+
+ItemArena::ItemArena( int slabSize )
+{
+	m_free = 0;
+	m_slotSize = 0;
+	m_slabSize = qMax( 1, slabSize );
+	m_count = 0;
+}
+
+ItemArena::~ItemArena()
+{
+	Q_ASSERT( m_count == 0 );
+	for(int s = 0; s < m_slabs.size(); ++s)
+		::operator delete( m_slabs.at(s) );
+}
+
+void* ItemArena::allocate( size_t size )
+{
+	//a whole number of headers keeps every slot aligned
+	size_t header = sizeof(Header);
+	size_t slot = header + ( size + header - 1 ) / header * header;
+	if( m_slotSize == 0 )
+		m_slotSize = slot;
+	if( slot > m_slotSize ) {
+		Header *h = static_cast<Header*>( ::operator new( slot ) );
+		h->arena = 0;
+		return h + 1;
+	}
+	if( !m_free )
+		grow();
+	Header *h = m_free;
+	m_free = h->next;
+	h->arena = this;
+	++m_count;
+	return h + 1;
+}
+
+void ItemArena::release( void *p )
+{
+	if( !p )
+		return;
+	Header *h = static_cast<Header*>( p ) - 1;
+	ItemArena *arena = h->arena;
+	if( !arena ) {
+		::operator delete( h );
+		return;
+	}
+	h->next = arena->m_free;
+	arena->m_free = h;
+	--arena->m_count;
+}
+
+void ItemArena::grow()
+{
+	char *slab = static_cast<char*>( ::operator new( m_slotSize * m_slabSize ) );
+	m_slabs.append( slab );
+	//linked back to front so the slots are handed out in order
+	for(int i = m_slabSize - 1; i >= 0; --i) {
+		Header *h = reinterpret_cast<Header*>( slab + i * m_slotSize );
+		h->next = m_free;
+		m_free = h;
+	}
+}
+
+int ItemArena::count() const
+{
+	return m_count;
+}
+
+int ItemArena::capacity() const
+{
+	return m_slabs.size() * m_slabSize;
+}
+
+int ItemArena::slabSize() const
+{
+	return m_slabSize;
+}
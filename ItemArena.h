@@ -0,0 +1,70 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef ITEMARENA_H
+#define ITEMARENA_H
+
+#include <cstddef>
+
+#include <QtCore/QVector>
+
+/**
+ * @brief Slab storage for objects of one size, owned by a graph
+ *
+ * Objects are carved out of slabs of slabSize() slots each. A released
+ * slot goes on a free list and is the next one handed out, so a graph
+ * that keeps gaining and losing vertices reuses its memory instead of
+ * fragmenting the heap. The slabs are only freed when the arena is
+ * destroyed, after every object in them; the objects themselves are
+ * destroyed one by one as usual.
+ *
+ * Every slot starts with a header naming its arena, so release() only
+ * needs the pointer; this is what lets a class use an arena from its own
+ * operator delete, wherever the object is deleted. The first allocation
+ * fixes the size of a slot; anything larger is left to the heap.
+ */
+class ItemArena
+{
+public:
+	/** @param slabSize the number of slots per slab */
+	ItemArena( int slabSize = 256 );
+	/** Frees the slabs, the objects in them must be destroyed already */
+	~ItemArena();
+
+	/** @return memory for an object of @p size bytes */
+	void* allocate( size_t size );
+	/** Gives back memory from allocate() of any arena */
+	static void release( void *p );
+
+	/** @return the number of slots handed out and not released */
+	int count() const;
+	/** @return the number of slots in all slabs */
+	int capacity() const;
+	int slabSize() const;
+
+private:
+	/** the start of every slot, either the owner or the next free slot */
+	union Header {
+		ItemArena *arena;
+		Header *next;
+		/// keeps the object after the header aligned for anything
+		double align[2];
+	};
+
+	void grow();
+
+	QVector<char*> m_slabs;
+	Header *m_free;
+	size_t m_slotSize;
+	int m_slabSize;
+	int m_count;
+
+	Q_DISABLE_COPY( ItemArena )
+};
+
+#endif //include guard
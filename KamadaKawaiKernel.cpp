@@ -0,0 +1,239 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "KamadaKawaiKernel.h"
+
+//math
+#include <cmath>
+
+#if defined(__GNUC__) && ( defined(__i386__) || defined(__x86_64__) )
+#define KK_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+/* All derivatives are sums over i != m of a term depending on
+ * dx = x_m - x_i, dy = y_m - y_i, d = |(dx,dy)| and the graph-theoretic
+ * distance d_mi, with the spring constant k = 1 / d_mi² and the spring
+ * length l = L d_mi, where L is the desirable length of an edge. On top of
+ * the springs every pair repels with the energy c / d:
+ *
+ *   dE/dx_m       += k (dx - l dx / d) - c dx / d³
+ *   dE/dy_m       += k (dy - l dy / d) - c dy / d³
+ *   d²E/dx_m²     += k (1 - l dy² / d³) + c (3 dx² / d⁵ - 1 / d³)
+ *   d²E/dx_m dy_m += k l dx dy / d³ + 3 c dx dy / d⁵
+ *   d²E/dy_m²     += k (1 - l dx² / d³) + c (3 dy² / d⁵ - 1 / d³)
+ *
+ * Every path below computes exactly these, only 1/d² and 1/d_mi are
+ * divided out and all other powers are products of them. */
+
+typedef void (*KernelFunction)( const qreal*, const qreal*, const qreal*,
+                                int, int, qreal, qreal, qreal, qreal,
+                                KKDerivatives* );
+
+static void derivativesGeneric( const qreal *x, const qreal *y,
+                                const qreal *dist, int begin, int end,
+                                qreal xm, qreal ym, qreal length, qreal c,
+                                KKDerivatives *r )
+{
+	for(int i = begin; i < end; ++i) {
+		qreal dx = xm - x[i];
+		qreal dy = ym - y[i];
+		qreal d2 = dx*dx + dy*dy;
+		qreal inv_d2 = 1.0 / d2;
+		qreal inv_d = sqrt( d2 ) * inv_d2;
+		qreal inv_d3 = inv_d * inv_d2;
+		qreal inv_d5 = inv_d3 * inv_d2;
+		qreal inv_dist = 1.0 / dist[i];
+		qreal k = inv_dist * inv_dist;
+		qreal kl = k * length * dist[i];
+		qreal g3 = c * inv_d3;
+		qreal g5 = 3.0 * c * inv_d5;
+		qreal a = k - kl * inv_d - g3;
+		r->gx += dx * a;
+		r->gy += dy * a;
+		qreal kl3 = kl * inv_d3;
+		qreal base = k - g3;
+		r->xx += base - kl3 * dy*dy + g5 * dx*dx;
+		r->yy += base - kl3 * dx*dx + g5 * dy*dy;
+		r->xy += ( kl3 + g5 ) * dx*dy;
+	}
+}
+
+#ifdef KK_X86_DISPATCH
+
+static inline double hsum( __m128d v )
+{
+	double lanes[2];
+	_mm_storeu_pd( lanes, v );
+	return lanes[0] + lanes[1];
+}
+
+__attribute__((target("sse2")))
+static void derivativesSse2( const qreal *x, const qreal *y,
+                             const qreal *dist, int begin, int end,
+                             qreal xm, qreal ym, qreal length, qreal c,
+                             KKDerivatives *r )
+{
+	const __m128d one = _mm_set1_pd( 1.0 );
+	const __m128d vlength = _mm_set1_pd( length );
+	const __m128d grav3 = _mm_set1_pd( c );
+	const __m128d grav5 = _mm_set1_pd( 3.0 * c );
+	const __m128d vxm = _mm_set1_pd( xm );
+	const __m128d vym = _mm_set1_pd( ym );
+	__m128d gx = _mm_setzero_pd(), gy = _mm_setzero_pd();
+	__m128d xx = _mm_setzero_pd(), xy = _mm_setzero_pd();
+	__m128d yy = _mm_setzero_pd();
+
+	int i = begin;
+	for(; i + 2 <= end; i += 2) {
+		__m128d dx = _mm_sub_pd( vxm, _mm_loadu_pd( x + i ) );
+		__m128d dy = _mm_sub_pd( vym, _mm_loadu_pd( y + i ) );
+		__m128d dx2 = _mm_mul_pd( dx, dx );
+		__m128d dy2 = _mm_mul_pd( dy, dy );
+		__m128d d2 = _mm_add_pd( dx2, dy2 );
+		__m128d inv_d2 = _mm_div_pd( one, d2 );
+		__m128d inv_d = _mm_mul_pd( _mm_sqrt_pd( d2 ), inv_d2 );
+		__m128d inv_d3 = _mm_mul_pd( inv_d, inv_d2 );
+		__m128d inv_d5 = _mm_mul_pd( inv_d3, inv_d2 );
+		__m128d vdist = _mm_loadu_pd( dist + i );
+		__m128d inv_dist = _mm_div_pd( one, vdist );
+		__m128d k = _mm_mul_pd( inv_dist, inv_dist );
+		__m128d kl = _mm_mul_pd( k, _mm_mul_pd( vlength, vdist ) );
+		__m128d g3 = _mm_mul_pd( grav3, inv_d3 );
+		__m128d g5 = _mm_mul_pd( grav5, inv_d5 );
+		__m128d a = _mm_sub_pd( _mm_sub_pd( k, _mm_mul_pd( kl, inv_d ) ), g3 );
+		gx = _mm_add_pd( gx, _mm_mul_pd( dx, a ) );
+		gy = _mm_add_pd( gy, _mm_mul_pd( dy, a ) );
+		__m128d kl3 = _mm_mul_pd( kl, inv_d3 );
+		__m128d base = _mm_sub_pd( k, g3 );
+		xx = _mm_add_pd( xx, _mm_add_pd( _mm_sub_pd( base,
+		         _mm_mul_pd( kl3, dy2 ) ), _mm_mul_pd( g5, dx2 ) ) );
+		yy = _mm_add_pd( yy, _mm_add_pd( _mm_sub_pd( base,
+		         _mm_mul_pd( kl3, dx2 ) ), _mm_mul_pd( g5, dy2 ) ) );
+		xy = _mm_add_pd( xy, _mm_mul_pd( _mm_add_pd( kl3, g5 ),
+		         _mm_mul_pd( dx, dy ) ) );
+	}
+	r->gx += hsum( gx );
+	r->gy += hsum( gy );
+	r->xx += hsum( xx );
+	r->xy += hsum( xy );
+	r->yy += hsum( yy );
+	derivativesGeneric( x, y, dist, i, end, xm, ym, length, c, r );
+}
+
+__attribute__((target("avx2")))
+static inline double hsum256( __m256d v )
+{
+	double lanes[4];
+	_mm256_storeu_pd( lanes, v );
+	return ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] );
+}
+
+__attribute__((target("avx2")))
+static void derivativesAvx2( const qreal *x, const qreal *y,
+                             const qreal *dist, int begin, int end,
+                             qreal xm, qreal ym, qreal length, qreal c,
+                             KKDerivatives *r )
+{
+	const __m256d one = _mm256_set1_pd( 1.0 );
+	const __m256d vlength = _mm256_set1_pd( length );
+	const __m256d grav3 = _mm256_set1_pd( c );
+	const __m256d grav5 = _mm256_set1_pd( 3.0 * c );
+	const __m256d vxm = _mm256_set1_pd( xm );
+	const __m256d vym = _mm256_set1_pd( ym );
+	__m256d gx = _mm256_setzero_pd(), gy = _mm256_setzero_pd();
+	__m256d xx = _mm256_setzero_pd(), xy = _mm256_setzero_pd();
+	__m256d yy = _mm256_setzero_pd();
+
+	int i = begin;
+	for(; i + 4 <= end; i += 4) {
+		__m256d dx = _mm256_sub_pd( vxm, _mm256_loadu_pd( x + i ) );
+		__m256d dy = _mm256_sub_pd( vym, _mm256_loadu_pd( y + i ) );
+		__m256d dx2 = _mm256_mul_pd( dx, dx );
+		__m256d dy2 = _mm256_mul_pd( dy, dy );
+		__m256d d2 = _mm256_add_pd( dx2, dy2 );
+		__m256d inv_d2 = _mm256_div_pd( one, d2 );
+		__m256d inv_d = _mm256_mul_pd( _mm256_sqrt_pd( d2 ), inv_d2 );
+		__m256d inv_d3 = _mm256_mul_pd( inv_d, inv_d2 );
+		__m256d inv_d5 = _mm256_mul_pd( inv_d3, inv_d2 );
+		__m256d vdist = _mm256_loadu_pd( dist + i );
+		__m256d inv_dist = _mm256_div_pd( one, vdist );
+		__m256d k = _mm256_mul_pd( inv_dist, inv_dist );
+		__m256d kl = _mm256_mul_pd( k, _mm256_mul_pd( vlength, vdist ) );
+		__m256d g3 = _mm256_mul_pd( grav3, inv_d3 );
+		__m256d g5 = _mm256_mul_pd( grav5, inv_d5 );
+		__m256d a = _mm256_sub_pd( _mm256_sub_pd( k, _mm256_mul_pd( kl, inv_d ) ), g3 );
+		gx = _mm256_add_pd( gx, _mm256_mul_pd( dx, a ) );
+		gy = _mm256_add_pd( gy, _mm256_mul_pd( dy, a ) );
+		__m256d kl3 = _mm256_mul_pd( kl, inv_d3 );
+		__m256d base = _mm256_sub_pd( k, g3 );
+		xx = _mm256_add_pd( xx, _mm256_add_pd( _mm256_sub_pd( base,
+		         _mm256_mul_pd( kl3, dy2 ) ), _mm256_mul_pd( g5, dx2 ) ) );
+		yy = _mm256_add_pd( yy, _mm256_add_pd( _mm256_sub_pd( base,
+		         _mm256_mul_pd( kl3, dx2 ) ), _mm256_mul_pd( g5, dy2 ) ) );
+		xy = _mm256_add_pd( xy, _mm256_mul_pd( _mm256_add_pd( kl3, g5 ),
+		         _mm256_mul_pd( dx, dy ) ) );
+	}
+	r->gx += hsum256( gx );
+	r->gy += hsum256( gy );
+	r->xx += hsum256( xx );
+	r->xy += hsum256( xy );
+	r->yy += hsum256( yy );
+	derivativesGeneric( x, y, dist, i, end, xm, ym, length, c, r );
+}
+
+#endif //KK_X86_DISPATCH
+
+static KernelFunction selectKernel( const char **name )
+{
+#ifdef KK_X86_DISPATCH
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "avx2" ) ) {
+		*name = "avx2";
+		return derivativesAvx2;
+	}
+	if( __builtin_cpu_supports( "sse2" ) ) {
+		*name = "sse2";
+		return derivativesSse2;
+	}
+#endif
+	*name = "generic";
+	return derivativesGeneric;
+}
+
+static const char *s_kernelName = 0;
+static KernelFunction s_kernel = selectKernel( &s_kernelName );
+
+void kkDerivatives( const qreal *x, const qreal *y, const qreal *dist,
+                    qreal length, qreal repulsion, int n, int m,
+                    KKDerivatives *result )
+{
+	result->gx = result->gy = 0.0;
+	result->xx = result->xy = result->yy = 0.0;
+	kkAddDerivatives( x, y, dist, length, repulsion, 0, n, m, result );
+}
+
+void kkAddDerivatives( const qreal *x, const qreal *y, const qreal *dist,
+                       qreal length, qreal repulsion, int begin, int end,
+                       int m, KKDerivatives *result )
+{
+	qreal xm = x[m], ym = y[m];
+	//the term for i == m is undefined, so sweep around it
+	if( m < begin || m >= end ) {
+		s_kernel( x, y, dist, begin, end, xm, ym, length, repulsion, result );
+	} else {
+		s_kernel( x, y, dist, begin, m, xm, ym, length, repulsion, result );
+		s_kernel( x, y, dist, m + 1, end, xm, ym, length, repulsion, result );
+	}
+}
+
+const char* kkKernelName()
+{
+	return s_kernelName;
+}
@@ -0,0 +1,61 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef KAMADAKAWAIKERNEL_H
+#define KAMADAKAWAIKERNEL_H
+
+#include <QtCore/QtGlobal>
+
+/**
+ * The partial derivatives of the Kamada-Kawai energy at one vertex m
+ */
+struct KKDerivatives
+{
+	qreal gx; ///< dE/dx_m, kk89 eq 7
+	qreal gy; ///< dE/dy_m, kk89 eq 8
+	qreal xx; ///< d²E/dx_m², kk89 eq 13
+	qreal xy; ///< d²E/dx_m dy_m, kk89 eq 14, eq 15
+	qreal yy; ///< d²E/dy_m², kk89 eq 16
+};
+
+/**
+ * @brief Computes all derivatives needed for the Newton step of vertex @p m
+ *
+ * This is a single sweep over contiguous coordinate arrays. On x86 an
+ * AVX2 or SSE2 code path is picked at runtime, anything else uses the
+ * plain C++ loop.
+ * @param x the x coordinates of all vertices
+ * @param y the y coordinates of all vertices
+ * @param dist the graph-theoretic distances between m and every vertex
+ * @param length the desirable length of an edge, L in kk89
+ * @param repulsion the strength c of the repulsion c / d between every
+ * pair, 0 for springs only
+ * @param n the number of vertices
+ * @param m the index of the vertex to compute the derivatives for
+ * @param result where to store the sums
+ */
+void kkDerivatives( const qreal *x, const qreal *y, const qreal *dist,
+                    qreal length, qreal repulsion, int n, int m,
+                    KKDerivatives *result );
+
+/**
+ * Like kkDerivatives(), but only sums over the vertices @p begin <= i < @p end
+ * and adds the sums to @p result instead of overwriting it. This is the
+ * piece a single thread does when the sweep is split up.
+ */
+void kkAddDerivatives( const qreal *x, const qreal *y, const qreal *dist,
+                       qreal length, qreal repulsion, int begin, int end,
+                       int m, KKDerivatives *result );
+
+/**
+ * @return the name of the code path kkDerivatives() uses on this machine,
+ * one of "avx2", "sse2" or "generic"
+ */
+const char* kkKernelName();
+
+#endif //include guard
@@ -0,0 +1,490 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "KamadaKawaiLayout.h"
+
+//math
+#include <cmath>
+
+// QtCore
+#include <QtCore/QVector>
+
+#include "Graph.h"
+#include "Vertex.h"
+#include "DistanceMatrix.h"
+#include "KamadaKawaiKernel.h"
+#include "QuadTree.h"
+#include "WorkerPool.h"
+
+#define force -0.1
+
+// below this many vertices the repulsion is always summed exactly
+static const int BARNESHUTLIMIT = 2048;
+
+/* Contribution of a vertex at offset (dx,dy) = m - i and graph-theoretic
+ * distance dist to dE/dx_m and dE/dy_m, kk89 eq 7, eq 8, plus the
+ * repulsion c / d between every pair. Both components are odd in (dx,dy),
+ * so the contribution of m to the gradient at i is the negation. */
+static inline void pairGradient( qreal dx, qreal dy, qreal dist, qreal c,
+                                 qreal *gx, qreal *gy )
+{
+	qreal d2 = dx*dx + dy*dy;
+	qreal d = sqrt( d2 );
+	qreal k = 1.0 / ( dist * dist );
+	qreal l = EDGELENGTH * dist;
+	qreal a = k - k * l / d - c / ( d2 * d );
+	*gx = a * dx;
+	*gy = a * dy;
+}
+
+/* The repulsion part of pairGradient() alone */
+static inline void repulsionGradient( qreal dx, qreal dy, qreal c,
+                                      qreal *gx, qreal *gy )
+{
+	qreal d2 = dx*dx + dy*dy;
+	qreal a = -c / ( d2 * sqrt( d2 ) );
+	*gx = a * dx;
+	*gy = a * dy;
+}
+
+KamadaKawaiLayout::KamadaKawaiLayout( Graph *g, WorkerPool *pool,
+                                      qreal theta )
+{
+	m_graph = g;
+	m_x = g->core()->xs();
+	m_y = g->core()->ys();
+	init( &g->distances(), pool, theta );
+}
+
+KamadaKawaiLayout::KamadaKawaiLayout( const QVector<qreal> &x,
+                                      const QVector<qreal> &y,
+                                      const DistanceMatrix *distances,
+                                      WorkerPool *pool, qreal theta )
+{
+	m_graph = 0;
+	m_x = x;
+	m_y = y;
+	init( distances, pool, theta );
+}
+
+KamadaKawaiLayout::KamadaKawaiLayout( Graph *g,
+                                      const KamadaKawaiCheckpoint &checkpoint,
+                                      WorkerPool *pool, qreal theta )
+{
+	m_graph = g;
+	m_x = checkpoint.x;
+	m_y = checkpoint.y;
+	init( &g->distances(), pool, theta, &checkpoint );
+}
+
+void KamadaKawaiLayout::init( const DistanceMatrix *distances,
+                              WorkerPool *pool, qreal theta,
+                              const KamadaKawaiCheckpoint *resume )
+{
+	//too large a graph has no distances, and nothing to lay out then
+	if( !distances->isValid() ) {
+		m_x.clear();
+		m_y.clear();
+	}
+	int n = m_x.size();
+	m_distances = distances;
+
+	m_ownPool = pool ? 0 : new WorkerPool( 1 );
+	m_pool = pool ? pool : m_ownPool;
+	m_parts = QVector<Part>( m_pool->threadCount() );
+	for(int p = 0; p < m_parts.size(); ++p)
+		m_parts[p].row = QVector<qreal>( n, 0.0 );
+
+	/* For large graphs the repulsion is left out of the exact sweeps and
+	 * cached separately, taken from a Barnes-Hut tree */
+	m_tree = 0;
+	m_repulsion = -1 * force;
+	if( theta > 0.0 && n >= BARNESHUTLIMIT ) {
+		m_tree = new QuadTree( theta );
+		m_tree->build( m_x.constData(), m_y.constData(), n );
+		m_repulsion = 0.0;
+		m_rx = QVector<qreal>( n, 0.0 );
+		m_ry = QVector<qreal>( n, 0.0 );
+	}
+
+	m_gx = QVector<qreal>( n, 0.0 );
+	m_gy = QVector<qreal>( n, 0.0 );
+	m_row = QVector<qreal>( n, 0.0 );
+	m_max = 0;
+	m_maxDelta = 0.0;
+	m_evaluations = 0;
+	if( !resume ) {
+		initialize();
+		return;
+	}
+	Q_ASSERT( resume->gx.size() == n && resume->gy.size() == n );
+	//the gradients hold the repulsion only if it was summed exactly
+	if( resume->tree != ( m_tree != 0 ) ) {
+		initialize();
+		return;
+	}
+	m_gx = resume->gx;
+	m_gy = resume->gy;
+	//the sweeps write to them from the worker threads
+	m_gx.detach();
+	m_gy.detach();
+	//the checkpoint has no repulsion from the tree
+	for(int m = 0; m < n && m_tree; ++m)
+		treeRepulsion( m );
+	//the same choice as reduceMax(), ties go to the highest index
+	m_maxDelta = -1.0;
+	for(int m = 0; m < n; ++m) {
+		qreal curdelta_m = delta_m( m );
+		if( curdelta_m >= m_maxDelta ) {
+			m_maxDelta = curdelta_m;
+			m_max = m;
+		}
+	}
+}
+
+KamadaKawaiLayout::~KamadaKawaiLayout()
+{
+	delete m_tree;
+	delete m_ownPool;
+}
+
+int KamadaKawaiLayout::size() const
+{
+	return m_x.size();
+}
+
+const QVector<qreal>& KamadaKawaiLayout::x() const
+{
+	return m_x;
+}
+
+const QVector<qreal>& KamadaKawaiLayout::y() const
+{
+	return m_y;
+}
+
+int KamadaKawaiLayout::run( int maxiter, qreal epsilon )
+{
+	if( size() == 0 )
+		return 0;
+	int iteration = 0;
+	while( iteration < maxiter && maxDelta() >= epsilon ) {
+		int m = maxVertex();
+		qreal dx, dy;
+		newtonStep( m, &dx, &dy );
+		move( m, dx, dy );
+		++iteration;
+	}
+	return iteration;
+}
+
+Vertex* KamadaKawaiLayout::vertex( int m ) const
+{
+	return m_graph ? m_graph->vertexAt(m) : 0;
+}
+
+int KamadaKawaiLayout::maxVertex() const
+{
+	return m_max;
+}
+
+qreal KamadaKawaiLayout::maxDelta() const
+{
+	return m_maxDelta;
+}
+
+const qreal* KamadaKawaiLayout::distances( int m ) const
+{
+	return m_distances->row( m, m_row.data() );
+}
+
+void KamadaKawaiLayout::gradient( int m, qreal *gx, qreal *gy,
+                                  qreal *scratch ) const
+{
+	*gx = 0.0;
+	*gy = 0.0;
+	const qreal *dist = m_distances->row( m, scratch );
+	const qreal *x = m_x.constData();
+	const qreal *y = m_y.constData();
+	for(int i = 0; i < m_x.size(); ++i) {
+		if( i == m )
+			continue;
+		qreal px, py;
+		pairGradient( x[m] - x[i], y[m] - y[i], dist[i], m_repulsion,
+		              &px, &py );
+		*gx += px;
+		*gy += py;
+	}
+}
+
+/* Every part finds the last of its largest delta_m, so going through the
+ * parts in order and letting ties win gives the same vertex a single
+ * thread would pick */
+void KamadaKawaiLayout::reduceMax()
+{
+	m_max = 0;
+	m_maxDelta = -1.0;
+	for(int p = 0; p < m_pool->parts( m_x.size() ); ++p) {
+		if( m_parts.at(p).maxDelta >= m_maxDelta ) {
+			m_maxDelta = m_parts.at(p).maxDelta;
+			m_max = m_parts.at(p).max;
+		}
+	}
+}
+
+void KamadaKawaiLayout::initialize()
+{
+	ParallelMemberTask<KamadaKawaiLayout> task( this,
+	                                     &KamadaKawaiLayout::initializePart );
+	m_pool->run( &task, m_x.size() );
+	reduceMax();
+	m_evaluations += (qint64)m_x.size() * ( m_x.size() - 1 );
+}
+
+void KamadaKawaiLayout::initializePart( int part, int begin, int end )
+{
+	Part &p = m_parts[part];
+	p.max = begin;
+	p.maxDelta = -1.0;
+	qreal *gx = m_gx.data();
+	qreal *gy = m_gy.data();
+	for(int m = begin; m < end; ++m) {
+		gradient( m, &gx[m], &gy[m], p.row.data() );
+		if( m_tree )
+			treeRepulsion( m );
+		qreal curdelta_m = delta_m( m );
+		if( curdelta_m >= p.maxDelta ) {
+			p.maxDelta = curdelta_m;
+			p.max = m;
+		}
+	}
+}
+
+void KamadaKawaiLayout::treeRepulsion( int m )
+{
+	KKDerivatives r;
+	m_tree->repulsion( m, -1 * force, &r );
+	m_rx[m] = r.gx;
+	m_ry[m] = r.gy;
+}
+
+//kk89 eq 9
+qreal KamadaKawaiLayout::delta_m( int m ) const
+{
+	qreal gx = m_gx.at(m);
+	qreal gy = m_gy.at(m);
+	if( m_tree ) {
+		gx += m_rx.at(m);
+		gy += m_ry.at(m);
+	}
+	return sqrt( gx*gx + gy*gy );
+}
+
+void KamadaKawaiLayout::move( int m, qreal dx, qreal dy )
+{
+	m_moving = m;
+	m_oldx = m_x.at(m);
+	m_oldy = m_y.at(m);
+	m_x[m] = m_oldx + dx;
+	m_y[m] = m_oldy + dy;
+	m_dist = distances( m );
+	if( m_tree ) {
+		m_tree->move( m, m_x.at(m), m_y.at(m) );
+		treeRepulsion( m );
+	}
+
+	ParallelMemberTask<KamadaKawaiLayout> task( this,
+	                                     &KamadaKawaiLayout::movePart );
+	m_pool->run( &task, m_x.size() );
+	reduceMax();
+	//the old and the new contribution of m to everyone
+	m_evaluations += 2 * ( m_x.size() - 1 );
+
+	qreal gxm = 0.0, gym = 0.0;
+	for(int p = 0; p < m_pool->parts( m_x.size() ); ++p) {
+		gxm += m_parts.at(p).gx;
+		gym += m_parts.at(p).gy;
+	}
+	m_gx[m] = gxm;
+	m_gy[m] = gym;
+	/* Ties go to the highest index, so m only wins a tie if it is past the
+	 * current maximum */
+	qreal mdelta_m = delta_m( m );
+	if( mdelta_m > m_maxDelta || ( mdelta_m == m_maxDelta && m > m_max ) ) {
+		m_maxDelta = mdelta_m;
+		m_max = m;
+	}
+}
+
+/* Only the pair terms involving m change: take the old contribution of
+ * m out of every other gradient and put the new one in. The gradient of
+ * m itself is the negated sum of the new contributions. The repulsion
+ * cached from the tree is patched the same way, with the exact pair terms,
+ * so it stays as close to the tree's sum as it was. */
+void KamadaKawaiLayout::movePart( int part, int begin, int end )
+{
+	Part &p = m_parts[part];
+	p.gx = 0.0;
+	p.gy = 0.0;
+	p.max = begin;
+	p.maxDelta = -1.0;
+	int m = m_moving;
+	qreal newx = m_x.at(m);
+	qreal newy = m_y.at(m);
+	const qreal *x = m_x.constData();
+	const qreal *y = m_y.constData();
+	qreal *gx = m_gx.data();
+	qreal *gy = m_gy.data();
+	qreal *rx = m_rx.data();
+	qreal *ry = m_ry.data();
+	for(int i = begin; i < end; ++i) {
+		//the final value of m is only known after the sweep
+		if( i == m )
+			continue;
+		qreal oldgx, oldgy, newgx, newgy;
+		pairGradient( x[i] - m_oldx, y[i] - m_oldy, m_dist[i], m_repulsion,
+		              &oldgx, &oldgy );
+		pairGradient( x[i] - newx, y[i] - newy, m_dist[i], m_repulsion,
+		              &newgx, &newgy );
+		gx[i] += newgx - oldgx;
+		gy[i] += newgy - oldgy;
+		p.gx -= newgx;
+		p.gy -= newgy;
+		if( m_tree ) {
+			repulsionGradient( x[i] - m_oldx, y[i] - m_oldy, -1 * force,
+			                   &oldgx, &oldgy );
+			repulsionGradient( x[i] - newx, y[i] - newy, -1 * force,
+			                   &newgx, &newgy );
+			rx[i] += newgx - oldgx;
+			ry[i] += newgy - oldgy;
+		}
+		qreal curdelta_m = delta_m( i );
+		if( curdelta_m >= p.maxDelta ) {
+			p.maxDelta = curdelta_m;
+			p.max = i;
+		}
+	}
+}
+
+//from kk89 eq 11, eq 12
+void KamadaKawaiLayout::newtonStep( int m, qreal *dx, qreal *dy )
+{
+	m_moving = m;
+	m_dist = distances( m );
+	ParallelMemberTask<KamadaKawaiLayout> task( this,
+	                                     &KamadaKawaiLayout::newtonPart );
+	m_pool->run( &task, m_x.size() );
+	m_evaluations += m_x.size() - 1;
+
+	KKDerivatives d = m_parts.at(0).derivatives;
+	for(int p = 1; p < m_pool->parts( m_x.size() ); ++p) {
+		const KKDerivatives &part = m_parts.at(p).derivatives;
+		d.gx += part.gx;
+		d.gy += part.gy;
+		d.xx += part.xx;
+		d.xy += part.xy;
+		d.yy += part.yy;
+	}
+	//the fresh sums also drop any drift the incremental updates picked up
+	m_gx[m] = d.gx;
+	m_gy[m] = d.gy;
+	if( m_tree ) {
+		KKDerivatives r;
+		m_tree->repulsion( m, -1 * force, &r );
+		m_rx[m] = r.gx;
+		m_ry[m] = r.gy;
+		d.gx += r.gx;
+		d.gy += r.gy;
+		d.xx += r.xx;
+		d.xy += r.xy;
+		d.yy += r.yy;
+	}
+
+	*dx = ( ( d.xy * d.gy ) / d.yy - d.gx ) / ( d.xx - d.xy * d.xy / d.yy );
+	*dy = ( ( d.xy * d.gx ) / d.xx - d.gy ) / ( d.yy - d.xy * d.xy / d.xx );
+}
+
+void KamadaKawaiLayout::newtonPart( int part, int begin, int end )
+{
+	KKDerivatives &d = m_parts[part].derivatives;
+	d.gx = d.gy = 0.0;
+	d.xx = d.xy = d.yy = 0.0;
+	kkAddDerivatives( m_x.constData(), m_y.constData(), m_dist, EDGELENGTH,
+	                  m_repulsion, begin, end, m_moving, &d );
+}
+
+void KamadaKawaiLayout::apply()
+{
+	if( !m_graph || size() == 0 )
+		return;
+	m_graph->core()->setPositions( m_x, m_y );
+	m_graph->updateItems();
+}
+
+void KamadaKawaiLayout::checkpoint( KamadaKawaiCheckpoint *checkpoint ) const
+{
+	checkpoint->x = m_x;
+	checkpoint->y = m_y;
+	checkpoint->gx = m_gx;
+	checkpoint->gy = m_gy;
+	checkpoint->tree = m_tree != 0;
+}
+
+qreal KamadaKawaiLayout::pairEnergy( qreal d, qreal dist )
+{
+	qreal k = 1.0 / ( dist * dist );
+	qreal l = EDGELENGTH * dist;
+	return 0.5 * k * ( d - l ) * ( d - l ) - force / d;
+}
+
+qreal KamadaKawaiLayout::pairEnergy( qreal count, qreal sum, qreal squares,
+                                     qreal inverses, qreal dist )
+{
+	qreal k = 1.0 / ( dist * dist );
+	qreal l = EDGELENGTH * dist;
+	return 0.5 * k * ( squares - 2.0 * l * sum + count * l * l )
+	       - force * inverses;
+}
+
+qreal KamadaKawaiLayout::energy() const
+{
+	int n = m_x.size();
+	qreal energy = 0.0;
+	for(int m = 0; m < n; ++m) {
+		const qreal *dist = distances( m );
+		for(int i = m + 1; i < n; ++i) {
+			qreal dx = m_x.at(i) - m_x.at(m);
+			qreal dy = m_y.at(i) - m_y.at(m);
+			energy += pairEnergy( sqrt( dx*dx + dy*dy ), dist[i] );
+		}
+	}
+	return energy;
+}
+
+qreal KamadaKawaiLayout::energyChange( int m, qreal dx, qreal dy ) const
+{
+	const qreal *dist = distances( m );
+	qreal oldx = m_x.at(m), oldy = m_y.at(m);
+	qreal newx = oldx + dx, newy = oldy + dy;
+	qreal change = 0.0;
+	for(int i = 0; i < m_x.size(); ++i) {
+		if( i == m )
+			continue;
+		qreal ox = m_x.at(i) - oldx, oy = m_y.at(i) - oldy;
+		qreal nx = m_x.at(i) - newx, ny = m_y.at(i) - newy;
+		change += pairEnergy( sqrt( nx*nx + ny*ny ), dist[i] )
+		          - pairEnergy( sqrt( ox*ox + oy*oy ), dist[i] );
+	}
+	return change;
+}
+
+qint64 KamadaKawaiLayout::evaluations() const
+{
+	return m_evaluations;
+}
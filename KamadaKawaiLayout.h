@@ -0,0 +1,249 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef KAMADAKAWAILAYOUT_H
+#define KAMADAKAWAILAYOUT_H
+
+#include <QtCore/QVector>
+
+#include "KamadaKawaiKernel.h"
+
+class DistanceMatrix;
+class Graph;
+class QuadTree;
+class Vertex;
+class WorkerPool;
+
+/**
+ * @brief Everything needed to carry on with a Kamada-Kawai layout later
+ *
+ * Filled by Graph::layoutKamadaKawaiFor(). Resuming from it skips the
+ * O(n²) computation of the gradients, so a layout can be run in slices of
+ * a time budget without losing anything in between. It is only valid
+ * for the graph it came from, while that keeps its vertices and edges.
+ */
+struct KamadaKawaiCheckpoint {
+	KamadaKawaiCheckpoint()
+	    : tree( false ), topology( 0 ), iteration( 0 ), energy( -1.0 ),
+	      converged( false ) {}
+	/** @return true if there is no layout to resume */
+	bool isNull() const { return x.isEmpty(); }
+
+	QVector<qreal> x;
+	QVector<qreal> y;
+	/// the cached dE/dx_m and dE/dy_m of every vertex, without the
+	/// repulsion from a Barnes-Hut tree, which is summed again on resume
+	QVector<qreal> gx;
+	QVector<qreal> gy;
+	/// true if the repulsion came from a tree and is not in gx and gy; a
+	/// layout that sums it the other way recomputes the gradients
+	bool tree;
+	/// GraphCore::topologyHash() of the graph, to tell whether it changed
+	quint64 topology;
+	/// the number of Newton steps done so far
+	int iteration;
+	/// the energy of the positions, -1 if it wasn't tracked
+	qreal energy;
+	/// true once no vertex had a delta_m above epsilon
+	bool converged;
+};
+
+/**
+ * @brief State of a Kamada-Kawai layout in progress
+ *
+ * Takes a snapshot of the vertex positions of a graph and keeps the
+ * gradient dE/dx_m, dE/dy_m of every vertex cached. Moving a single vertex
+ * only changes its own contribution to everyone else's gradient, so after
+ * a move the cache is patched in O(n) instead of being recomputed in O(n²).
+ * The vertex with the largest delta_m is found during the same sweep.
+ *
+ * All sweeps are split over the threads of a WorkerPool. The per-thread
+ * results are combined in a fixed order, so the layout only depends on the
+ * starting positions and the number of threads.
+ *
+ * On large graphs the repulsion between all pairs can be taken from a
+ * Barnes-Hut QuadTree. It is cached next to the gradients of the springs
+ * and patched pair by pair on every move like them, so the choice of the
+ * vertex to move and the stop at epsilon include it. The springs still
+ * join every pair, so a move stays O(n) either way; the tree only saves
+ * the repulsion terms of the sweeps, not an order of growth.
+ */
+class KamadaKawaiLayout
+{
+public:
+	/**
+	 * Snapshots the vertex positions of @p g and fills the gradient cache.
+	 * The spring lengths come from Graph::distances(), which is computed
+	 * here if the graph changed since the last layout.
+	 * @param g the graph to lay out
+	 * @param pool the threads to use, 0 to run on the calling thread only
+	 * @param theta the Barnes-Hut opening criterion for the repulsion,
+	 * 0 to sum it exactly. Small graphs always use the exact sum.
+	 */
+	KamadaKawaiLayout( Graph *g, WorkerPool *pool = 0, qreal theta = 0.0 );
+	/**
+	 * Lays out points that are not vertices of a Graph, e.g. a coarsened
+	 * copy of one. apply() does nothing for these, use x() and y().
+	 * @param x the starting x coordinates
+	 * @param y the starting y coordinates
+	 * @param distances the graph-theoretic distances between the points
+	 */
+	KamadaKawaiLayout( const QVector<qreal> &x, const QVector<qreal> &y,
+	                   const DistanceMatrix *distances, WorkerPool *pool = 0,
+	                   qreal theta = 0.0 );
+	/**
+	 * Resumes a layout of @p g from the positions and gradients in
+	 * @p checkpoint in O(n), instead of taking a snapshot of the vertices
+	 * and computing the gradients in O(n²). If the repulsion was taken
+	 * from a tree then and is summed exactly now, or the other way round,
+	 * the gradients are computed again from the saved positions.
+	 */
+	KamadaKawaiLayout( Graph *g, const KamadaKawaiCheckpoint &checkpoint,
+	                   WorkerPool *pool = 0, qreal theta = 0.0 );
+	~KamadaKawaiLayout();
+
+	/**
+	 * @return the number of vertices in the snapshot, 0 if the distances
+	 * are invalid because the graph is too large for them
+	 */
+	int size() const;
+	/** @return the vertex at index @p m, only for a layout of a Graph */
+	Vertex* vertex( int m ) const;
+
+	/** @return the current x coordinates */
+	const QVector<qreal>& x() const;
+	/** @return the current y coordinates */
+	const QVector<qreal>& y() const;
+
+	/**
+	 * Moves the vertex with the largest delta_m until @p maxiter moves are
+	 * done or no vertex has a delta_m of @p epsilon or more
+	 * @return the number of moves done
+	 */
+	int run( int maxiter, qreal epsilon );
+
+	/** @return the index of the vertex with the largest delta_m */
+	int maxVertex() const;
+	/** @return the largest delta_m, the one of maxVertex() */
+	qreal maxDelta() const;
+
+	/** @return the cached delta_m of vertex @p m, kk89 eq 9 */
+	qreal delta_m( int m ) const;
+
+	/**
+	 * Computes the Newton step for @p m, kk89 eq 11, eq 12, from a single
+	 * sweep over all vertices. This also refreshes the cached gradient of m.
+	 * @param m the vertex to move
+	 * @param dx where to store the x component of the step
+	 * @param dy where to store the y component of the step
+	 */
+	void newtonStep( int m, qreal *dx, qreal *dy );
+
+	/**
+	 * Moves vertex @p m by @p dx, @p dy and updates the cached gradients
+	 * of every vertex and the choice of maxVertex() in O(n).
+	 */
+	void move( int m, qreal dx, qreal dy );
+
+	/** Writes the positions in the snapshot back to the vertices */
+	void apply();
+	/** Stores the positions and cached gradients in @p checkpoint */
+	void checkpoint( KamadaKawaiCheckpoint *checkpoint ) const;
+
+	/**
+	 * @return the energy of the current positions, summed over all pairs
+	 * in O(n²). This includes the repulsion even where it comes from the
+	 * Barnes-Hut tree.
+	 */
+	qreal energy() const;
+	/**
+	 * @return how much energy() would change by moving vertex @p m by
+	 * @p dx, @p dy, computed in O(n)
+	 */
+	qreal energyChange( int m, qreal dx, qreal dy ) const;
+	/**
+	 * @return the number of pairs whose contribution to a gradient has been
+	 * evaluated so far, the work done by the exact sweeps
+	 */
+	qint64 evaluations() const;
+
+	/**
+	 * @return the energy of a pair of vertices @p d apart at the
+	 * graph-theoretic distance @p dist, the spring of kk89 eq 2 plus the
+	 * repulsion. The gradients used here are its derivatives.
+	 */
+	static qreal pairEnergy( qreal d, qreal dist );
+	/**
+	 * @return pairEnergy() summed over @p count pairs at the same @p dist,
+	 * given the sums of their distances d, of d² and of 1 / d
+	 */
+	static qreal pairEnergy( qreal count, qreal sum, qreal squares,
+	                         qreal inverses, qreal dist );
+
+private:
+	void init( const DistanceMatrix *distances, WorkerPool *pool,
+	           qreal theta, const KamadaKawaiCheckpoint *resume = 0 );
+
+	/// what one thread found during a sweep
+	struct Part {
+		qreal gx, gy; ///< contribution to the gradient of the moved vertex
+		int max; ///< the vertex with the largest delta_m in the part
+		qreal maxDelta;
+		KKDerivatives derivatives;
+		QVector<qreal> row; ///< room for a row of a packed distance matrix
+	};
+
+	/** recomputes every cached gradient from scratch, O(n²) */
+	void initialize();
+	/** @return the gradient at @p m, computed in O(n) */
+	void gradient( int m, qreal *gx, qreal *gy, qreal *scratch ) const;
+	/** @return the graph-theoretic distances from @p m to all vertices */
+	inline const qreal* distances( int m ) const;
+	/** sums the repulsion on @p m from the tree into the cache */
+	void treeRepulsion( int m );
+	/** picks the overall maxVertex() from the parts */
+	void reduceMax();
+
+	void initializePart( int part, int begin, int end );
+	void movePart( int part, int begin, int end );
+	void newtonPart( int part, int begin, int end );
+
+	Graph *m_graph;
+	const DistanceMatrix *m_distances;
+	QVector<qreal> m_x;
+	QVector<qreal> m_y;
+	// cached dE/dx_m and dE/dy_m
+	QVector<qreal> m_gx;
+	QVector<qreal> m_gy;
+	// room for a row of a packed distance matrix
+	mutable QVector<qreal> m_row;
+	int m_max;
+	qreal m_maxDelta;
+	qint64 m_evaluations;
+
+	// Barnes-Hut tree for the repulsion, 0 if it is in the exact sweeps
+	QuadTree *m_tree;
+	// strength of the repulsion in the exact sweeps
+	qreal m_repulsion;
+	// cached repulsion part of dE/dx_m and dE/dy_m, only with a tree
+	QVector<qreal> m_rx;
+	QVector<qreal> m_ry;
+
+	WorkerPool *m_pool;
+	WorkerPool *m_ownPool;
+	QVector<Part> m_parts;
+	// the vertex being moved and where it came from, for the sweeps
+	int m_moving;
+	qreal m_oldx;
+	qreal m_oldy;
+	const qreal *m_dist;
+
+	Q_DISABLE_COPY( KamadaKawaiLayout )
+};
+
+#endif //include guard
@@ -0,0 +1,120 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "LabelMetrics.h"
+
+// QtCore
+#include <QtCore/QCoreApplication>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+// QtGui
+#include <QtGui/QApplication>
+#include <QtGui/QFont>
+#include <QtGui/QFontMetrics>
+
+// an estimated line is this many times as high as the font's pixel size
+static const qreal LINEHEIGHT = 1.2;
+// an estimated character is this many times as wide as the pixel size
+static const qreal CHARWIDTH = 0.6;
+// the pixels per point of the estimates, a 96 dpi screen
+static const qreal PIXELSPERPOINT = 96.0 / 72.0;
+
+/* The metrics of every font asked for, by QFont::key() */
+static QHash<QString,LabelMetrics*> fonts;
+static QMutex fontsMutex;
+
+QString LabelPool::intern( const QString &label )
+{
+	QSet<QString>::const_iterator i = m_labels.constFind( label );
+	if( i != m_labels.constEnd() )
+		return *i;
+	m_labels.insert( label );
+	return label;
+}
+
+int LabelPool::size() const
+{
+	return m_labels.size();
+}
+
+LabelMetrics* LabelMetrics::forFont( const QFont &font )
+{
+	QMutexLocker lock( &fontsMutex );
+	LabelMetrics *&metrics = fonts[font.key()];
+	if( !metrics )
+		metrics = new LabelMetrics( font );
+	return metrics;
+}
+
+/* Only reads what the font was asked for, which needs no font engine */
+LabelMetrics::LabelMetrics( const QFont &font )
+{
+	m_font = new QFont( font );
+	m_metrics = 0;
+	qreal pixels = font.pixelSize() > 0 ? font.pixelSize()
+	                                    : font.pointSizeF() * PIXELSPERPOINT;
+	m_lineHeight = LINEHEIGHT * pixels;
+	m_charWidth = CHARWIDTH * pixels;
+}
+
+LabelMetrics::~LabelMetrics()
+{
+	delete m_metrics;
+	delete m_font;
+}
+
+bool LabelMetrics::canMeasure()
+{
+	QCoreApplication *app = QCoreApplication::instance();
+	return app && qobject_cast<QApplication*>( app )
+	       && QThread::currentThread() == app->thread();
+}
+
+QSizeF LabelMetrics::estimate( const QString &label ) const
+{
+	return QSizeF( label.length() * m_charWidth, m_lineHeight );
+}
+
+QSizeF LabelMetrics::size( const QString &label )
+{
+	{
+		QReadLocker lock( &m_lock );
+		QHash<QString,QSizeF>::const_iterator i = m_sizes.constFind( label );
+		if( i != m_sizes.constEnd() )
+			return i.value();
+	}
+	if( !canMeasure() )
+		return estimate( label );
+	QWriteLocker lock( &m_lock );
+	//another thread may have measured it while we waited for the lock
+	QHash<QString,QSizeF>::const_iterator i = m_sizes.constFind( label );
+	if( i != m_sizes.constEnd() )
+		return i.value();
+	if( !m_metrics )
+		m_metrics = new QFontMetrics( *m_font );
+	QSizeF size( m_metrics->boundingRect( label ).size() );
+	m_sizes.insert( label, size );
+	return size;
+}
+
+QVector<QSizeF> LabelMetrics::sizes( const QVector<QString> &labels )
+{
+	QVector<QSizeF> sizes( labels.size() );
+	for(int i = 0; i < labels.size(); ++i)
+		sizes[i] = size( labels.at(i) );
+	return sizes;
+}
+
+int LabelMetrics::count() const
+{
+	QReadLocker lock( &m_lock );
+	return m_sizes.size();
+}
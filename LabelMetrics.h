@@ -0,0 +1,98 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef LABELMETRICS_H
+#define LABELMETRICS_H
+
+#include <QtCore/QHash>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QSet>
+#include <QtCore/QSizeF>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class QFont;
+class QFontMetrics;
+
+/**
+ * @brief Hands out one shared copy of every distinct label
+ *
+ * Friend graphs have many vertices with the same name. Passing every
+ * label through intern() while reading makes the equal ones share a
+ * single string buffer instead of one each.
+ */
+class LabelPool
+{
+public:
+	/** @return the copy of @p label kept by the pool, @p label if new */
+	QString intern( const QString &label );
+	/** @return the number of distinct labels seen */
+	int size() const;
+
+private:
+	QSet<QString> m_labels;
+};
+
+/**
+ * @brief The sizes of labels drawn in a font, measured once each
+ *
+ * Measuring a text goes through the font engine of QtGui, which is slow
+ * when it is done for every vertex of a large graph. This keeps the size
+ * of every label measured so far, so a label that comes up again, or a
+ * graph that is shown again, costs a hash lookup.
+ *
+ * The font engine may only be used on the GUI thread of a QApplication.
+ * Anywhere else, in a tool with just a QCoreApplication or on a worker
+ * thread, a label that hasn't been measured yet gets an estimate from the
+ * font size instead, which is not kept. So size() may be called from any
+ * thread: lookups only take a read lock, and the measuring of new labels
+ * is done one at a time. Only this file needs QtGui, so layouts that want
+ * sizes can use this header alone.
+ */
+class LabelMetrics
+{
+public:
+	/**
+	 * @return the metrics of @p font, made on first use. Everyone asking
+	 * for the same font shares them, and they live as long as the program.
+	 */
+	static LabelMetrics* forFont( const QFont &font );
+
+	/**
+	 * @return the size of the bounding rect of @p label, estimated where
+	 * it can't be measured
+	 */
+	QSizeF size( const QString &label );
+	/** @return the sizes of @p labels, in the same order */
+	QVector<QSizeF> sizes( const QVector<QString> &labels );
+	/** @return the number of labels measured so far */
+	int count() const;
+
+private:
+	LabelMetrics( const QFont &font );
+	~LabelMetrics();
+
+	/** @return true if the font engine may be used here */
+	static bool canMeasure();
+	/** @return the size of @p label guessed from the size of the font */
+	QSizeF estimate( const QString &label ) const;
+
+	QFont *m_font;
+	/// made on the first measurement, 0 until then
+	QFontMetrics *m_metrics;
+	/// the height of a line and the width of an average character
+	qreal m_lineHeight;
+	qreal m_charWidth;
+	/// the keys share their strings with the labels measured
+	QHash<QString,QSizeF> m_sizes;
+	mutable QReadWriteLock m_lock;
+
+	Q_DISABLE_COPY( LabelMetrics )
+};
+
+#endif //include guard
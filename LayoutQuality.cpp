@@ -0,0 +1,349 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "LayoutQuality.h"
+
+//math
+#include <cmath>
+
+// C++ std lib for sorting the edges
+#include <algorithm>
+
+#include "GraphCore.h"
+#include "KamadaKawaiLayout.h"
+#include "RandomGenerator.h"
+#include "WorkerPool.h"
+
+// graphs up to this size are measured from every source
+static const int ALLSOURCESLIMIT = 4096;
+// the number of sources sampled on larger graphs
+static const int SAMPLEDSOURCES = 256;
+
+/* Orders the edges by their left end for the sweep */
+struct LeftOf {
+	template<class S>
+	bool operator()( const S &s, const S &t ) const { return s.x1 < t.x1; }
+};
+
+/* @return twice the signed area of the triangle a b c, positive if it
+ * turns left */
+static inline qreal orientation( qreal ax, qreal ay, qreal bx, qreal by,
+                                 qreal cx, qreal cy )
+{
+	return ( bx - ax ) * ( cy - ay ) - ( by - ay ) * ( cx - ax );
+}
+
+/* @return true if the ends of one segment lie strictly on both sides of
+ * the other, for both of them */
+template<class S>
+static inline bool cross( const S &s, const S &t )
+{
+	qreal o1 = orientation( s.x1, s.y1, s.x2, s.y2, t.x1, t.y1 );
+	qreal o2 = orientation( s.x1, s.y1, s.x2, s.y2, t.x2, t.y2 );
+	if( !( ( o1 > 0.0 && o2 < 0.0 ) || ( o1 < 0.0 && o2 > 0.0 ) ) )
+		return false;
+	qreal o3 = orientation( t.x1, t.y1, t.x2, t.y2, s.x1, s.y1 );
+	qreal o4 = orientation( t.x1, t.y1, t.x2, t.y2, s.x2, s.y2 );
+	return ( o3 > 0.0 && o4 < 0.0 ) || ( o3 < 0.0 && o4 > 0.0 );
+}
+
+LayoutQuality::LayoutQuality( const GraphCore *core, WorkerPool *pool )
+{
+	m_core = core;
+	m_ownPool = pool ? 0 : new WorkerPool( 1 );
+	m_pool = pool ? pool : m_ownPool;
+	m_requestedSources = -1;
+	m_seed = 21184;
+	m_stress = -1.0;
+	m_energy = -1.0;
+	m_lengthMean = -1.0;
+	m_lengthSpread = -1.0;
+	m_crossings = -1;
+}
+
+LayoutQuality::~LayoutQuality()
+{
+	delete m_ownPool;
+}
+
+void LayoutQuality::setSources( int sources )
+{
+	m_requestedSources = sources;
+}
+
+void LayoutQuality::setSeed( quint64 seed )
+{
+	m_seed = seed;
+}
+
+void LayoutQuality::compute( int metrics )
+{
+	m_stress = -1.0;
+	m_energy = -1.0;
+	m_lengthMean = -1.0;
+	m_lengthSpread = -1.0;
+	m_crossings = -1;
+	m_sources.clear();
+	if( metrics & Distances )
+		measureDistances();
+	if( metrics & EdgeLengths )
+		measureEdgeLengths();
+	if( metrics & Crossings )
+		measureCrossings();
+}
+
+void LayoutQuality::measureDistances()
+{
+	int n = m_core->size();
+	int count = m_requestedSources;
+	if( count < 0 )
+		count = n <= ALLSOURCESLIMIT ? 0 : SAMPLEDSOURCES;
+	if( count == 0 || count > n )
+		count = n;
+
+	//the first count entries of a random permutation, sorted so the
+	//sample only depends on the seed
+	QVector<int> order( n );
+	for(int i = 0; i < n; ++i)
+		order[i] = i;
+	if( count < n ) {
+		RandomGenerator random( m_seed );
+		for(int i = 0; i < count; ++i)
+			qSwap( order[i], order[i + random.below( n - i )] );
+	}
+	order.resize( count );
+	m_sources = order;
+	std::sort( m_sources.begin(), m_sources.end() );
+
+	m_adjacency = m_core->adjacency();
+	m_sums = QVector<Sums>( count );
+	//a search takes about as long from every source, but there are
+	//usually too few of them for run() to split
+	ParallelMemberTask<LayoutQuality> task( this,
+	                                        &LayoutQuality::distancesPart );
+	m_pool->runEach( &task, count );
+	m_adjacency = DistanceMatrix::Adjacency();
+
+	Sums total;
+	total.scaled = total.squares = total.pairs = total.energy = 0.0;
+	total.diameter = 0.0;
+	total.apart = total.apartSum = total.apartSquares = 0.0;
+	total.apartInverses = 0.0;
+	for(int s = 0; s < count; ++s) {
+		const Sums &sums = m_sums.at(s);
+		total.scaled += sums.scaled;
+		total.squares += sums.squares;
+		total.pairs += sums.pairs;
+		total.energy += sums.energy;
+		total.diameter = qMax( total.diameter, sums.diameter );
+		total.apart += sums.apart;
+		total.apartSum += sums.apartSum;
+		total.apartSquares += sums.apartSquares;
+		total.apartInverses += sums.apartInverses;
+	}
+	m_sums.clear();
+
+	/* With the drawing scaled by s the stress is s² squares - 2 s scaled
+	 * + pairs, which is smallest at s = scaled / squares */
+	m_stress = 0.0;
+	if( total.pairs > 0.0 )
+		m_stress = total.squares > 0.0
+		           ? 1.0 - total.scaled * total.scaled
+		                   / ( total.squares * total.pairs )
+		           : 1.0;
+	m_stress = qMax( m_stress, (qreal)0.0 );
+
+	//disconnected pairs are as far apart as in DistanceMatrix
+	qreal energy = total.energy;
+	if( total.apart > 0.0 )
+		energy += KamadaKawaiLayout::pairEnergy( total.apart, total.apartSum,
+		                                         total.apartSquares,
+		                                         total.apartInverses,
+		                                         total.diameter + 1.0 );
+	//every pair was seen from both ends when all sources are searched
+	m_energy = count > 0 ? energy * n / ( 2.0 * count ) : 0.0;
+}
+
+void LayoutQuality::distancesPart( int part, int begin, int end )
+{
+	Q_UNUSED( part );
+	const qreal *x = m_core->xs().constData();
+	const qreal *y = m_core->ys().constData();
+	int n = m_core->size();
+	for(int s = begin; s < end; ++s) {
+		int i = m_sources.at(s);
+		QVector<qreal> dist = DistanceMatrix::shortestPaths( m_adjacency, i );
+		Sums sums;
+		sums.scaled = sums.squares = sums.pairs = sums.energy = 0.0;
+		sums.diameter = 0.0;
+		sums.apart = sums.apartSum = sums.apartSquares = 0.0;
+		sums.apartInverses = 0.0;
+		for(int j = 0; j < n; ++j) {
+			if( j == i )
+				continue;
+			qreal dx = x[j] - x[i];
+			qreal dy = y[j] - y[i];
+			qreal d2 = dx*dx + dy*dy;
+			qreal d = sqrt( d2 );
+			qreal dij = dist.at(j);
+			if( dij < 0.0 ) {
+				sums.apart += 1.0;
+				sums.apartSum += d;
+				sums.apartSquares += d2;
+				sums.apartInverses += 1.0 / d;
+				continue;
+			}
+			sums.scaled += d / dij;
+			sums.squares += d2 / ( dij * dij );
+			sums.pairs += 1.0;
+			sums.energy += KamadaKawaiLayout::pairEnergy( d, dij );
+			sums.diameter = qMax( sums.diameter, dij );
+		}
+		m_sums[s] = sums;
+	}
+}
+
+void LayoutQuality::measureEdgeLengths()
+{
+	const QVector<qreal> &x = m_core->xs();
+	const QVector<qreal> &y = m_core->ys();
+	int m = m_core->edgeCount();
+	QVector<qreal> lengths;
+	lengths.reserve( m );
+	qreal sum = 0.0;
+	for(int e = 0; e < m; ++e) {
+		int a = m_core->head( e );
+		int b = m_core->tail( e );
+		if( a == b )
+			continue;
+		qreal dx = x.at(b) - x.at(a);
+		qreal dy = y.at(b) - y.at(a);
+		lengths.append( sqrt( dx*dx + dy*dy ) );
+		sum += lengths.last();
+	}
+	m_lengthMean = 0.0;
+	m_lengthSpread = 0.0;
+	if( lengths.isEmpty() )
+		return;
+	m_lengthMean = sum / lengths.size();
+	qreal variance = 0.0;
+	for(int e = 0; e < lengths.size(); ++e)
+		variance += ( lengths.at(e) - m_lengthMean )
+		            * ( lengths.at(e) - m_lengthMean );
+	variance /= lengths.size();
+	if( m_lengthMean > 0.0 )
+		m_lengthSpread = sqrt( variance ) / m_lengthMean;
+}
+
+void LayoutQuality::measureCrossings()
+{
+	const QVector<qreal> &x = m_core->xs();
+	const QVector<qreal> &y = m_core->ys();
+	int m = m_core->edgeCount();
+	m_segments.clear();
+	m_segments.reserve( m );
+	for(int e = 0; e < m; ++e) {
+		Segment s;
+		s.a = m_core->head( e );
+		s.b = m_core->tail( e );
+		if( s.a == s.b )
+			continue;
+		if( x.at(s.b) < x.at(s.a) )
+			qSwap( s.a, s.b );
+		s.x1 = x.at(s.a);
+		s.y1 = y.at(s.a);
+		s.x2 = x.at(s.b);
+		s.y2 = y.at(s.b);
+		s.bottom = qMin( s.y1, s.y2 );
+		s.top = qMax( s.y1, s.y2 );
+		m_segments.append( s );
+	}
+	std::sort( m_segments.begin(), m_segments.end(), LeftOf() );
+
+	int count = m_segments.size();
+	m_crossingParts = QVector<qint64>( m_pool->threadCount(), 0 );
+	ParallelMemberTask<LayoutQuality> task( this,
+	                                        &LayoutQuality::crossingsPart );
+	m_pool->run( &task, count );
+	m_crossings = 0;
+	for(int p = 0; p < m_crossingParts.size(); ++p)
+		m_crossings += m_crossingParts.at(p);
+	m_segments.clear();
+}
+
+/* Sweeps over the segments that start in [begin, end), testing each
+ * against the earlier ones still open where it starts. Every crossing is
+ * counted once, by the part of the segment that starts later. */
+void LayoutQuality::crossingsPart( int part, int begin, int end )
+{
+	const Segment *segments = m_segments.constData();
+	QVector<int> active;
+	//the segments of earlier parts still open at the start of this one
+	if( begin < end )
+		for(int j = 0; j < begin; ++j)
+			if( segments[j].x2 >= segments[begin].x1 )
+				active.append( j );
+
+	qint64 crossings = 0;
+	for(int i = begin; i < end; ++i) {
+		const Segment &s = segments[i];
+		int kept = 0;
+		for(int k = 0; k < active.size(); ++k) {
+			const Segment &t = segments[active.at(k)];
+			//closed on the left of the sweep, and of every later segment
+			if( t.x2 < s.x1 )
+				continue;
+			active[kept++] = active.at(k);
+			if( t.top < s.bottom || t.bottom > s.top )
+				continue;
+			if( t.a == s.a || t.a == s.b || t.b == s.a || t.b == s.b )
+				continue;
+			if( cross( s, t ) )
+				++crossings;
+		}
+		active.resize( kept );
+		active.append( i );
+	}
+	m_crossingParts[part] = crossings;
+}
+
+qreal LayoutQuality::stress() const
+{
+	return m_stress;
+}
+
+qreal LayoutQuality::energy() const
+{
+	return m_energy;
+}
+
+int LayoutQuality::sourceCount() const
+{
+	return m_sources.size();
+}
+
+bool LayoutQuality::isSampled() const
+{
+	return !m_sources.isEmpty() && m_sources.size() < m_core->size();
+}
+
+qreal LayoutQuality::edgeLengthMean() const
+{
+	return m_lengthMean;
+}
+
+qreal LayoutQuality::edgeLengthSpread() const
+{
+	return m_lengthSpread;
+}
+
+qint64 LayoutQuality::crossings() const
+{
+	return m_crossings;
+}
@@ -0,0 +1,144 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef LAYOUTQUALITY_H
+#define LAYOUTQUALITY_H
+
+#include <QtCore/QVector>
+
+#include "DistanceMatrix.h"
+
+class GraphCore;
+class WorkerPool;
+
+/**
+ * @brief Measures how good the current positions of a graph are
+ *
+ * The stress and the Kamada-Kawai energy compare the distances in the
+ * drawing with the graph-theoretic ones. They take one shortest path
+ * search per source vertex; on large graphs only a random sample of the
+ * sources is searched, which gives an estimate in O(sources * m) instead
+ * of the exact values in O(n * m). The searches run in parallel and are
+ * summed in a fixed order, so the results don't depend on the threads.
+ *
+ * Crossings are counted with a sweep from left to right over the edges
+ * sorted by their left end. Each edge is only tested against the edges
+ * still open at its left end whose vertical extent overlaps its own, so a
+ * reasonably spread out layout takes far fewer than the m² tests of
+ * trying every pair. A tangled one still takes about m², so callers
+ * should leave Crossings out for large graphs. Edges that share a vertex
+ * never count as crossing, neither do edges that only touch.
+ */
+class LayoutQuality
+{
+public:
+	/// what compute() measures, or-ed together
+	enum Metric {
+		Distances = 1,   ///< stress() and energy()
+		EdgeLengths = 2, ///< edgeLengthMean() and edgeLengthSpread()
+		Crossings = 4,   ///< crossings()
+		All = 7
+	};
+
+	/**
+	 * @param core the graph and the positions to measure, which must not
+	 * change while compute() runs
+	 * @param pool the threads to use, 0 for just the calling one
+	 */
+	LayoutQuality( const GraphCore *core, WorkerPool *pool = 0 );
+	~LayoutQuality();
+
+	/**
+	 * Sets the number of source vertices of the shortest path searches
+	 * @param sources 0 for all of them, -1 for all of them on small graphs
+	 * and a sample on large ones (the default)
+	 */
+	void setSources( int sources );
+	/** Sets the seed the sample of the sources is drawn with */
+	void setSeed( quint64 seed );
+
+	/** Measures the @p metrics, see Metric; the others are set to -1 */
+	void compute( int metrics = All );
+
+	/**
+	 * @return the stress of the layout scaled to fit the graph-theoretic
+	 * distances d_ij best, normalized by its value for a layout with all
+	 * vertices in one point: sum (s |x_i - x_j| - d_ij)² / d_ij² over the
+	 * connected pairs, divided by their number. 0 means the drawing shows
+	 * the distances exactly, whatever its size.
+	 */
+	qreal stress() const;
+	/**
+	 * @return the energy layoutKamadaKawai() minimizes, with pairs in
+	 * different components at the largest distance plus one
+	 */
+	qreal energy() const;
+	/** @return the number of source vertices the last compute() searched */
+	int sourceCount() const;
+	/** @return true if stress() and energy() are estimates from a sample */
+	bool isSampled() const;
+
+	/** @return the average length of an edge in the drawing */
+	qreal edgeLengthMean() const;
+	/**
+	 * @return the standard deviation of the lengths of the edges divided
+	 * by their mean, 0 if all edges are equally long
+	 */
+	qreal edgeLengthSpread() const;
+
+	/** @return the number of pairs of edges that cross */
+	qint64 crossings() const;
+
+private:
+	/// what the search from one source saw
+	struct Sums {
+		qreal scaled;   ///< sum of |x_i - x_j| / d_ij over connected pairs
+		qreal squares;  ///< sum of |x_i - x_j|² / d_ij² over connected pairs
+		qreal pairs;    ///< number of connected pairs
+		qreal energy;   ///< Kamada-Kawai energy of the connected pairs
+		qreal diameter; ///< largest distance to a connected vertex
+		/// number of vertices in other components and the sums of their
+		/// distances, squared distances and inverse distances in the drawing
+		qreal apart, apartSum, apartSquares, apartInverses;
+	};
+
+	/// an edge going from left to right
+	struct Segment {
+		qreal x1, y1, x2, y2;
+		qreal bottom, top;
+		int a, b; ///< the vertices at the ends
+	};
+
+	void measureDistances();
+	void measureEdgeLengths();
+	void measureCrossings();
+
+	void distancesPart( int part, int begin, int end );
+	void crossingsPart( int part, int begin, int end );
+
+	const GraphCore *m_core;
+	WorkerPool *m_pool;
+	WorkerPool *m_ownPool;
+	int m_requestedSources;
+	quint64 m_seed;
+
+	DistanceMatrix::Adjacency m_adjacency;
+	QVector<int> m_sources;
+	QVector<Sums> m_sums;
+	/// sorted by the left end
+	QVector<Segment> m_segments;
+	QVector<qint64> m_crossingParts;
+
+	qreal m_stress;
+	qreal m_energy;
+	qreal m_lengthMean;
+	qreal m_lengthSpread;
+	qint64 m_crossings;
+};
+
+#endif //include guard
@@ -0,0 +1,64 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "LayoutTelemetry.h"
+
+LayoutTelemetry::LayoutTelemetry( int capacity )
+    : m_samples( qMax( 1, capacity ) )
+{
+	m_total = 0;
+	m_timer.start();
+}
+
+LayoutTelemetry::~LayoutTelemetry()
+{
+}
+
+void LayoutTelemetry::start()
+{
+	m_total = 0;
+	m_timer.start();
+}
+
+void LayoutTelemetry::record( LayoutSample sample )
+{
+	sample.nsecs = m_timer.nsecsElapsed();
+	LayoutSample &slot = m_samples[m_total % m_samples.size()];
+	slot = sample;
+	++m_total;
+	sampled( slot );
+}
+
+int LayoutTelemetry::size() const
+{
+	return (int)qMin( m_total, (qint64)m_samples.size() );
+}
+
+int LayoutTelemetry::capacity() const
+{
+	return m_samples.size();
+}
+
+qint64 LayoutTelemetry::total() const
+{
+	return m_total;
+}
+
+const LayoutSample& LayoutTelemetry::at( int i ) const
+{
+	Q_ASSERT( i >= 0 && i < size() );
+	//once the ring is full the oldest is the one written next
+	qint64 first = m_total - size();
+	return m_samples.at( ( first + i ) % m_samples.size() );
+}
+
+void LayoutTelemetry::sampled( const LayoutSample &sample )
+{
+	Q_UNUSED( sample );
+}
@@ -0,0 +1,87 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef LAYOUTTELEMETRY_H
+#define LAYOUTTELEMETRY_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QVector>
+
+/**
+ * What one iteration of a layout did. Fields a layout can't tell cheaply
+ * are -1.
+ */
+struct LayoutSample {
+	int iteration;
+	/// the vertex that moved, -1 if all of them did
+	int vertex;
+	/// the energy the layout minimizes after the iteration
+	qreal energy;
+	/// the largest delta_m left, kk89 eq 9
+	qreal maxDelta;
+	/// how far the vertex moved, or the farthest any vertex moved
+	qreal step;
+	/// pair derivative evaluations since the layout started
+	qint64 evaluations;
+	/// wall time since the layout started
+	qint64 nsecs;
+};
+
+/**
+ * @brief Records what a layout does in every iteration
+ *
+ * Set one with Graph::setTelemetry() before a layout. The last capacity()
+ * samples are kept in a ring buffer, and sampled() is called for every one
+ * of them as it comes in, for whoever wants to watch or keep them all.
+ *
+ * The layout loops are templates over their recorder. Without telemetry
+ * they are instantiated with NoTelemetry, whose Enabled is a compile time
+ * 0, so the instrumentation is not in the code that runs at all.
+ */
+class LayoutTelemetry
+{
+public:
+	enum { Enabled = 1 };
+
+	/** @param capacity the number of samples kept */
+	LayoutTelemetry( int capacity = 4096 );
+	virtual ~LayoutTelemetry();
+
+	/** Forgets all samples and starts the clock, called as a layout starts */
+	void start();
+	/** Stamps @p sample with the time, keeps it and calls sampled() */
+	void record( LayoutSample sample );
+
+	/** @return the number of samples kept, at most capacity() */
+	int size() const;
+	int capacity() const;
+	/** @return the number of samples recorded since start(), kept or not */
+	qint64 total() const;
+	/** @return sample @p i of the ones kept, 0 is the oldest */
+	const LayoutSample& at( int i ) const;
+
+protected:
+	/** Called for every sample after it has been kept, does nothing */
+	virtual void sampled( const LayoutSample &sample );
+
+private:
+	QVector<LayoutSample> m_samples;
+	qint64 m_total;
+	QElapsedTimer m_timer;
+};
+
+/**
+ * Stands in for a LayoutTelemetry when there is none
+ */
+struct NoTelemetry {
+	enum { Enabled = 0 };
+	void start() {}
+	void record( const LayoutSample& ) {}
+};
+
+#endif //include guard
@@ -0,0 +1,321 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "MultilevelLayout.h"
+
+//math
+#include <cmath>
+
+// QtCore
+#include <QtCore/QMap>
+
+#include "Graph.h"
+#include "KamadaKawaiLayout.h"
+#include "QuadTree.h"
+#include "RandomGenerator.h"
+#include "WorkerPool.h"
+
+// a level this small is laid out directly
+static const int COARSESTSIZE = 50;
+// the coarsest level is laid out with Kamada-Kawai up to this size
+static const int KAMADAKAWAILIMIT = 500;
+// Kamada-Kawai moves per vertex of the coarsest level
+static const int KAMADAKAWAIMOVES = 50;
+// a level that shrinks by less than this is not worth having
+static const qreal MINREDUCTION = 0.1;
+// the strength of the repulsion relative to EDGELENGTH³
+static const qreal REPULSION = 0.2;
+// the step control of Hu, "Efficient and high quality force-directed
+// graph drawing", 2005
+static const qreal STEPFACTOR = 0.9;
+static const int STEPPROGRESS = 5;
+// refinement stops once the step is down to this times EDGELENGTH
+static const qreal TOLERANCE = 0.01;
+
+MultilevelLayout::MultilevelLayout( Graph *g, RandomGenerator *random,
+                                    WorkerPool *pool, qreal theta )
+{
+	m_random = random;
+	m_pool = pool;
+	m_theta = theta;
+
+	m_graph = g;
+	Level level;
+	level.adjacency = g->core()->adjacency();
+	m_levels.append( level );
+	while( m_levels.last().adjacency.size() > COARSESTSIZE && coarsen() )
+		;
+}
+
+int MultilevelLayout::levels() const
+{
+	return m_levels.size();
+}
+
+int MultilevelLayout::size( int level ) const
+{
+	return m_levels.at( level ).adjacency.size();
+}
+
+QVector<int> MultilevelLayout::shuffled( int level )
+{
+	int n = size( level );
+	QVector<int> order( n );
+	for(int i = 0; i < n; ++i)
+		order[i] = i;
+	for(int i = n - 1; i > 0; --i)
+		qSwap( order[i], order[ m_random->below( i + 1 ) ] );
+	return order;
+}
+
+int MultilevelLayout::match( int level )
+{
+	Level &fine = m_levels[level];
+	int n = fine.adjacency.size();
+	fine.parent = QVector<int>( n, -1 );
+	QVector<int> order = shuffled( level );
+
+	//pair each vertex with its neighbour of the lowest degree, which keeps
+	//hubs free for the leaves that have nobody else to pair with
+	int coarse = 0;
+	for(int j = 0; j < n; ++j) {
+		int i = order.at(j);
+		if( fine.parent.at(i) >= 0 )
+			continue;
+		const QVector< QPair<int,qreal> > &adjacent = fine.adjacency.at(i);
+		int best = -1;
+		for(int k = 0; k < adjacent.size(); ++k) {
+			int u = adjacent.at(k).first;
+			if( u == i || fine.parent.at(u) >= 0 )
+				continue;
+			if( best < 0 ||
+			    fine.adjacency.at(u).size() < fine.adjacency.at(best).size() )
+				best = u;
+		}
+		fine.parent[i] = coarse;
+		if( best >= 0 )
+			fine.parent[best] = coarse;
+		++coarse;
+	}
+	return coarse;
+}
+
+int MultilevelLayout::collapseIndependent( int level )
+{
+	Level &fine = m_levels[level];
+	int n = fine.adjacency.size();
+	fine.parent = QVector<int>( n, -1 );
+
+	//visit hubs first so a star collapses into its centre
+	QVector<int> order = shuffled( level );
+	QMap<int, QList<int> > byDegree;
+	for(int j = 0; j < n; ++j)
+		byDegree[ -fine.adjacency.at( order.at(j) ).size() ].append( order.at(j) );
+	order.clear();
+	for(QMap<int, QList<int> >::const_iterator i = byDegree.constBegin();
+	    i != byDegree.constEnd(); ++i )
+		for(int j = 0; j < i->size(); ++j)
+			order.append( i->at(j) );
+
+	QVector<bool> centre( n, false );
+	int coarse = 0;
+	for(int j = 0; j < n; ++j) {
+		int i = order.at(j);
+		bool covered = false;
+		const QVector< QPair<int,qreal> > &adjacent = fine.adjacency.at(i);
+		for(int k = 0; k < adjacent.size() && !covered; ++k)
+			covered = centre.at( adjacent.at(k).first );
+		if( !covered ) {
+			centre[i] = true;
+			fine.parent[i] = coarse++;
+		}
+	}
+	//the set is maximal, so everybody else has a neighbour in it
+	for(int i = 0; i < n; ++i) {
+		const QVector< QPair<int,qreal> > &adjacent = fine.adjacency.at(i);
+		for(int k = 0; k < adjacent.size() && !centre.at(i); ++k) {
+			int u = adjacent.at(k).first;
+			if( centre.at(u) ) {
+				fine.parent[i] = fine.parent.at(u);
+				break;
+			}
+		}
+	}
+	return coarse;
+}
+
+bool MultilevelLayout::coarsen()
+{
+	int level = m_levels.size() - 1;
+	int n = size( level );
+	int coarse = match( level );
+	if( coarse > n * ( 1.0 - MINREDUCTION ) )
+		coarse = collapseIndependent( level );
+	if( coarse > n * ( 1.0 - MINREDUCTION ) ) {
+		m_levels[level].parent.clear();
+		return false;
+	}
+
+	const Level &fine = m_levels.at( level );
+	QVector< QList<int> > members( coarse );
+	for(int i = 0; i < n; ++i)
+		members[ fine.parent.at(i) ].append( i );
+
+	//an edge between two groups becomes one edge of length 1, the marker
+	//remembers which group last got an edge to a coarse vertex
+	Level next;
+	next.adjacency = DistanceMatrix::Adjacency( coarse );
+	QVector<int> marker( coarse, -1 );
+	for(int p = 0; p < coarse; ++p) {
+		marker[p] = p;
+		for(int j = 0; j < members.at(p).size(); ++j) {
+			const QVector< QPair<int,qreal> > &adjacent =
+			    fine.adjacency.at( members.at(p).at(j) );
+			for(int k = 0; k < adjacent.size(); ++k) {
+				int q = fine.parent.at( adjacent.at(k).first );
+				if( marker.at(q) == p )
+					continue;
+				marker[q] = p;
+				next.adjacency[p].append( qMakePair( q, (qreal)1.0 ) );
+			}
+		}
+	}
+	m_levels.append( next );
+	return true;
+}
+
+void MultilevelLayout::layoutCoarsest()
+{
+	Level &level = m_levels.last();
+	int n = level.adjacency.size();
+	qreal side = EDGELENGTH * sqrt( (qreal)n );
+	level.x = QVector<qreal>( n );
+	level.y = QVector<qreal>( n );
+	for(int i = 0; i < n; ++i) {
+		level.x[i] = ( m_random->uniform() - 0.5 ) * side;
+		level.y[i] = ( m_random->uniform() - 0.5 ) * side;
+	}
+	if( n < 2 || n > KAMADAKAWAILIMIT )
+		return;
+
+	//the coarse edges all have length 1, so this is a breadth first search
+	DistanceMatrix distances;
+	distances.compute( level.adjacency, DistanceMatrix::Full,
+	                   m_pool ? m_pool->threadCount() : 1 );
+	KamadaKawaiLayout kk( level.x, level.y, &distances, m_pool );
+	kk.run( KAMADAKAWAIMOVES * n, 1e-6 );
+	level.x = kk.x();
+	level.y = kk.y();
+}
+
+void MultilevelLayout::project( int level )
+{
+	Level &fine = m_levels[level];
+	const Level &coarse = m_levels.at( level + 1 );
+	int n = fine.adjacency.size();
+	//a coarse vertex stands for about n / size( level + 1 ) vertices, which
+	//take up that much more area
+	qreal scale = sqrt( (qreal)n / coarse.adjacency.size() );
+	fine.x = QVector<qreal>( n );
+	fine.y = QVector<qreal>( n );
+	for(int i = 0; i < n; ++i) {
+		//jitter, or the vertices of a group would sit on top of each other
+		int p = fine.parent.at(i);
+		fine.x[i] = coarse.x.at(p) * scale
+		          + ( m_random->uniform() - 0.5 ) * 0.2 * EDGELENGTH;
+		fine.y[i] = coarse.y.at(p) * scale
+		          + ( m_random->uniform() - 0.5 ) * 0.2 * EDGELENGTH;
+	}
+}
+
+void MultilevelLayout::refine( int level, int sweeps )
+{
+	Level &l = m_levels[level];
+	int n = l.adjacency.size();
+	if( n < 2 )
+		return;
+	//only the graph itself has edges of different lengths
+	qreal lengthScale = level == 0 ? EDGELENGTH : 0.0;
+	qreal c = REPULSION * EDGELENGTH * EDGELENGTH * EDGELENGTH;
+
+	QuadTree tree( m_theta );
+	tree.build( l.x.constData(), l.y.constData(), n );
+
+	qreal step = EDGELENGTH;
+	qreal energy = 0.0;
+	int progress = 0;
+	for(int sweep = 0; sweep < sweeps; ++sweep) {
+		qreal oldEnergy = energy;
+		energy = 0.0;
+		for(int i = 0; i < n; ++i) {
+			//the gradient of the sum of 1/2 (d - length)² over the edges ...
+			qreal gx = 0.0, gy = 0.0;
+			const QVector< QPair<int,qreal> > &adjacent = l.adjacency.at(i);
+			for(int k = 0; k < adjacent.size(); ++k) {
+				int j = adjacent.at(k).first;
+				qreal dx = l.x.at(i) - l.x.at(j);
+				qreal dy = l.y.at(i) - l.y.at(j);
+				qreal d = sqrt( dx*dx + dy*dy );
+				if( d == 0.0 )
+					continue;
+				qreal length = lengthScale > 0.0
+				             ? lengthScale * adjacent.at(k).second : EDGELENGTH;
+				gx += ( 1.0 - length / d ) * dx;
+				gy += ( 1.0 - length / d ) * dy;
+			}
+			//... and of c / d over all pairs
+			KKDerivatives r;
+			tree.repulsion( i, c, &r );
+			gx += r.gx;
+			gy += r.gy;
+
+			qreal g = sqrt( gx*gx + gy*gy );
+			energy += g * g;
+			if( g == 0.0 )
+				continue;
+			l.x[i] -= step * gx / g;
+			l.y[i] -= step * gy / g;
+			tree.move( i, l.x.at(i), l.y.at(i) );
+		}
+
+		if( sweep > 0 && energy < oldEnergy ) {
+			if( ++progress >= STEPPROGRESS ) {
+				progress = 0;
+				step /= STEPFACTOR;
+			}
+		} else {
+			progress = 0;
+			step *= STEPFACTOR;
+		}
+		if( step < TOLERANCE * EDGELENGTH )
+			break;
+	}
+}
+
+void MultilevelLayout::run( int sweeps )
+{
+	if( size( 0 ) == 0 )
+		return;
+	layoutCoarsest();
+	if( size( m_levels.size() - 1 ) > KAMADAKAWAILIMIT )
+		refine( m_levels.size() - 1, sweeps );
+	for(int level = m_levels.size() - 2; level >= 0; --level) {
+		project( level );
+		refine( level, sweeps );
+	}
+}
+
+void MultilevelLayout::apply()
+{
+	const Level &level = m_levels.at(0);
+	if( level.x.size() != m_graph->core()->size() )
+		return;
+	m_graph->core()->setPositions( level.x, level.y );
+	m_graph->updateItems();
+}
@@ -0,0 +1,95 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef MULTILEVELLAYOUT_H
+#define MULTILEVELLAYOUT_H
+
+#include <QtCore/QList>
+#include <QtCore/QVector>
+
+#include "DistanceMatrix.h"
+
+class Graph;
+class RandomGenerator;
+class WorkerPool;
+
+/**
+ * @brief Coarsen, lay out and refine
+ *
+ * The graph is collapsed into a hierarchy of ever smaller graphs. Each
+ * level pairs up neighbours with a random matching; where that barely
+ * shrinks the graph, as around the hub of a star, every vertex joins a
+ * neighbour from a maximal independent set instead. The smallest level is
+ * laid out with Kamada-Kawai, then each level takes the positions of the
+ * vertices it was collapsed into and is refined with a few force-directed
+ * sweeps using springs on the edges and Barnes-Hut repulsion.
+ *
+ * Only the first level is tied to the vertices of the Graph, so the work
+ * is near linear in the size of the graph.
+ */
+class MultilevelLayout
+{
+public:
+	/**
+	 * Builds the hierarchy
+	 * @param g the graph to lay out
+	 * @param random the source of the matching order and of the jitter
+	 * @param pool the threads used for the coarsest level, 0 for one
+	 * @param theta the Barnes-Hut opening criterion of the repulsion
+	 */
+	MultilevelLayout( Graph *g, RandomGenerator *random, WorkerPool *pool = 0,
+	                  qreal theta = 0.7 );
+
+	/** @return the number of levels, the graph itself is level 0 */
+	int levels() const;
+	/** @return the number of vertices in level @p level */
+	int size( int level ) const;
+
+	/**
+	 * Lays out the coarsest level and refines the others
+	 * @param sweeps the maximum number of sweeps per level
+	 */
+	void run( int sweeps );
+
+	/** Writes the positions of level 0 back to the vertices */
+	void apply();
+
+private:
+	/// one graph of the hierarchy
+	struct Level {
+		DistanceMatrix::Adjacency adjacency;
+		/// the vertex of the next coarser level each vertex collapsed into
+		QVector<int> parent;
+		QVector<qreal> x;
+		QVector<qreal> y;
+	};
+
+	/** @return false if the last level can't be collapsed any further */
+	bool coarsen();
+	/** @return a random order of the vertices of @p level */
+	QVector<int> shuffled( int level );
+	/**
+	 * Pairs up neighbours, coarsen() decides whether that shrinks the level
+	 * enough
+	 * @return the number of coarse vertices
+	 */
+	int match( int level );
+	int collapseIndependent( int level );
+
+	void layoutCoarsest();
+	void project( int level );
+	void refine( int level, int sweeps );
+
+	Graph *m_graph;
+	QList<Level> m_levels;
+	RandomGenerator *m_random;
+	WorkerPool *m_pool;
+	qreal m_theta;
+};
+
+#endif //include guard
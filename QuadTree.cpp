@@ -0,0 +1,273 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "QuadTree.h"
+
+//math
+#include <cmath>
+
+// QtCore
+#include <QtCore/QVector>
+
+// a leaf holding more points than this is split
+static const int LEAFSIZE = 8;
+// cells this deep are never split, so coincident points can't recurse forever
+static const int MAXDEPTH = 24;
+
+/* Adds the derivatives of the energy c / d for a mass at offset (dx,dy) */
+static inline void addRepulsion( qreal dx, qreal dy, qreal c,
+                                 KKDerivatives *r )
+{
+	qreal d2 = dx*dx + dy*dy;
+	qreal inv_d2 = 1.0 / d2;
+	qreal inv_d3 = sqrt( d2 ) * inv_d2 * inv_d2;
+	qreal g3 = c * inv_d3;
+	qreal g5 = 3.0 * g3 * inv_d2;
+	r->gx -= g3 * dx;
+	r->gy -= g3 * dy;
+	r->xx += g5 * dx*dx - g3;
+	r->yy += g5 * dy*dy - g3;
+	r->xy += g5 * dx*dy;
+}
+
+QuadTree::QuadTree( qreal theta )
+{
+	m_theta = theta;
+}
+
+int QuadTree::size() const
+{
+	return m_x.size();
+}
+
+qreal QuadTree::theta() const
+{
+	return m_theta;
+}
+
+void QuadTree::setTheta( qreal theta )
+{
+	m_theta = qMax( (qreal)0.0, theta );
+}
+
+int QuadTree::newCell( int parent, qreal cx, qreal cy, qreal half, int depth )
+{
+	Cell cell;
+	cell.cx = cx;
+	cell.cy = cy;
+	cell.half = half;
+	cell.sx = cell.sy = 0.0;
+	cell.count = 0;
+	cell.parent = parent;
+	cell.child = -1;
+	cell.depth = depth;
+	m_cells.append( cell );
+	return m_cells.size() - 1;
+}
+
+void QuadTree::build( const qreal *x, const qreal *y, int n )
+{
+	m_cells.clear();
+	m_x = QVector<qreal>( n );
+	m_y = QVector<qreal>( n );
+	m_leaf = QVector<int>( n, -1 );
+
+	qreal minx = 0.0, maxx = 0.0, miny = 0.0, maxy = 0.0;
+	for(int i = 0; i < n; ++i) {
+		m_x[i] = x[i];
+		m_y[i] = y[i];
+		if( i == 0 || x[i] < minx ) minx = x[i];
+		if( i == 0 || x[i] > maxx ) maxx = x[i];
+		if( i == 0 || y[i] < miny ) miny = y[i];
+		if( i == 0 || y[i] > maxy ) maxy = y[i];
+	}
+	//leave some room so points on the border stay inside for a while
+	qreal half = qMax( maxx - minx, maxy - miny ) * 0.55 + 1.0;
+	newCell( -1, ( minx + maxx ) / 2, ( miny + maxy ) / 2, half, 0 );
+
+	for(int i = 0; i < n; ++i)
+		insert( i );
+}
+
+inline int QuadTree::childFor( int c, qreal x, qreal y ) const
+{
+	const Cell &cell = m_cells.at(c);
+	return cell.child + ( x >= cell.cx ? 1 : 0 ) + ( y >= cell.cy ? 2 : 0 );
+}
+
+void QuadTree::addMass( int c, qreal x, qreal y, int count )
+{
+	for(; c >= 0; c = m_cells.at(c).parent) {
+		Cell &cell = m_cells[c];
+		cell.sx += x * count;
+		cell.sy += y * count;
+		cell.count += count;
+	}
+}
+
+void QuadTree::insert( int i )
+{
+	qreal x = m_x.at(i);
+	qreal y = m_y.at(i);
+	int c = 0;
+	while( m_cells.at(c).child >= 0 )
+		c = childFor( c, x, y );
+	addMass( c, x, y, 1 );
+	m_cells[c].points.append( i );
+	m_leaf[i] = c;
+	if( m_cells.at(c).points.size() > LEAFSIZE
+	    && m_cells.at(c).depth < MAXDEPTH )
+		split( c );
+}
+
+void QuadTree::split( int c )
+{
+	//newCell() may move m_cells, so no references across it
+	qreal cx = m_cells.at(c).cx;
+	qreal cy = m_cells.at(c).cy;
+	qreal quarter = m_cells.at(c).half / 2;
+	int depth = m_cells.at(c).depth + 1;
+	int child = newCell( c, cx - quarter, cy - quarter, quarter, depth );
+	newCell( c, cx + quarter, cy - quarter, quarter, depth );
+	newCell( c, cx - quarter, cy + quarter, quarter, depth );
+	newCell( c, cx + quarter, cy + quarter, quarter, depth );
+	m_cells[c].child = child;
+
+	QVector<int> points = m_cells.at(c).points;
+	m_cells[c].points.clear();
+	for(int j = 0; j < points.size(); ++j) {
+		int i = points.at(j);
+		int ch = childFor( c, m_x.at(i), m_y.at(i) );
+		Cell &cell = m_cells[ch];
+		cell.sx += m_x.at(i);
+		cell.sy += m_y.at(i);
+		cell.count += 1;
+		cell.points.append( i );
+		m_leaf[i] = ch;
+	}
+	for(int ch = child; ch < child + 4; ++ch)
+		if( m_cells.at(ch).points.size() > LEAFSIZE && depth < MAXDEPTH )
+			split( ch );
+}
+
+void QuadTree::move( int i, qreal x, qreal y )
+{
+	qreal oldx = m_x.at(i);
+	qreal oldy = m_y.at(i);
+	m_x[i] = x;
+	m_y[i] = y;
+
+	int leaf = m_leaf.at(i);
+	const Cell &cell = m_cells.at(leaf);
+	if( x >= cell.cx - cell.half && x < cell.cx + cell.half &&
+	    y >= cell.cy - cell.half && y < cell.cy + cell.half ) {
+		//still in the same leaf, only the centres of mass move
+		for(int c = leaf; c >= 0; c = m_cells.at(c).parent) {
+			m_cells[c].sx += x - oldx;
+			m_cells[c].sy += y - oldy;
+		}
+		return;
+	}
+
+	addMass( leaf, oldx, oldy, -1 );
+	QVector<int> &points = m_cells[leaf].points;
+	points.remove( points.indexOf( i ) );
+
+	const Cell &root = m_cells.at(0);
+	if( x >= root.cx - root.half && x < root.cx + root.half &&
+	    y >= root.cy - root.half && y < root.cy + root.half ) {
+		insert( i );
+	} else {
+		QVector<qreal> xs = m_x, ys = m_y;
+		build( xs.constData(), ys.constData(), xs.size() );
+	}
+}
+
+void QuadTree::repulsion( int i, qreal c, KKDerivatives *result ) const
+{
+	result->gx = result->gy = 0.0;
+	result->xx = result->xy = result->yy = 0.0;
+	if( m_cells.isEmpty() )
+		return;
+
+	qreal px = m_x.at(i);
+	qreal py = m_y.at(i);
+	qreal theta2 = m_theta * m_theta;
+	//a depth first walk never has more than 3 siblings per level waiting
+	int stack[3 * MAXDEPTH + 4];
+	int top = 0;
+	stack[top++] = 0;
+	while( top > 0 ) {
+		const Cell &cell = m_cells.at( stack[--top] );
+		if( cell.count == 0 )
+			continue;
+		if( cell.child < 0 ) {
+			for(int j = 0; j < cell.points.size(); ++j) {
+				int k = cell.points.at(j);
+				if( k != i )
+					addRepulsion( px - m_x.at(k), py - m_y.at(k), c, result );
+			}
+			continue;
+		}
+		qreal dx = px - cell.sx / cell.count;
+		qreal dy = py - cell.sy / cell.count;
+		qreal side = 2.0 * cell.half;
+		bool inside = qAbs( px - cell.cx ) <= cell.half &&
+		              qAbs( py - cell.cy ) <= cell.half;
+		if( !inside && side * side < theta2 * ( dx*dx + dy*dy ) ) {
+			addRepulsion( dx, dy, c * cell.count, result );
+		} else {
+			for(int ch = 0; ch < 4; ++ch)
+				stack[top++] = cell.child + ch;
+		}
+	}
+}
+
+bool QuadTree::points( const QRectF &rect, int limit,
+                       QVector<int> *result ) const
+{
+	if( m_cells.isEmpty() )
+		return true;
+	qreal minx = rect.left(), maxx = rect.right();
+	qreal miny = rect.top(), maxy = rect.bottom();
+	int found = 0;
+	int stack[3 * MAXDEPTH + 4];
+	int top = 0;
+	stack[top++] = 0;
+	while( top > 0 ) {
+		const Cell &cell = m_cells.at( stack[--top] );
+		if( cell.count == 0 )
+			continue;
+		if( cell.cx + cell.half < minx || cell.cx - cell.half > maxx ||
+		    cell.cy + cell.half < miny || cell.cy - cell.half > maxy )
+			continue;
+		//a cell wholly inside has all of its points in the result
+		bool inside = cell.cx - cell.half >= minx
+		              && cell.cx + cell.half <= maxx
+		              && cell.cy - cell.half >= miny
+		              && cell.cy + cell.half <= maxy;
+		if( inside && found + cell.count > limit )
+			return false;
+		if( cell.child >= 0 ) {
+			for(int ch = 0; ch < 4; ++ch)
+				stack[top++] = cell.child + ch;
+			continue;
+		}
+		for(int j = 0; j < cell.points.size(); ++j) {
+			int k = cell.points.at(j);
+			qreal x = m_x.at(k), y = m_y.at(k);
+			if( x < minx || x > maxx || y < miny || y > maxy )
+				continue;
+			if( ++found > limit )
+				return false;
+			result->append( k );
+		}
+	}
+	return true;
+}
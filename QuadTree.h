@@ -0,0 +1,105 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include <QtCore/QRectF>
+#include <QtCore/QVector>
+
+#include "KamadaKawaiKernel.h"
+
+/**
+ * @brief Barnes-Hut quadtree over a set of points
+ *
+ * Approximates the repulsion energy sum c / d over all pairs of points.
+ * A cell that looks small from the query point, size / distance < theta,
+ * is treated as all of its points sitting at their centre of mass, which
+ * makes a query O(log n) instead of O(n). A theta of 0 opens every cell
+ * and gives the exact sum.
+ *
+ * Points are addressed by their index in the arrays given to build(). A
+ * point that moves is refitted with move(), which only touches the cells
+ * on its path to the root.
+ */
+class QuadTree
+{
+public:
+	/** @param theta the opening criterion, see setTheta() */
+	QuadTree( qreal theta = 0.7 );
+
+	/**
+	 * Builds the tree from scratch
+	 * @param x the x coordinates of the points
+	 * @param y the y coordinates of the points
+	 * @param n the number of points
+	 */
+	void build( const qreal *x, const qreal *y, int n );
+
+	/** @return the number of points in the tree */
+	int size() const;
+
+	/**
+	 * Moves point @p i to @p x, @p y and updates the cells above it. If the
+	 * point leaves the bounds of the whole tree, it is rebuilt.
+	 */
+	void move( int i, qreal x, qreal y );
+
+	/** @return the opening criterion */
+	qreal theta() const;
+	/**
+	 * Sets the opening criterion. Larger is faster and less accurate, 0.5
+	 * to 1.0 are the usual values.
+	 */
+	void setTheta( qreal theta );
+
+	/**
+	 * Computes the derivatives of the repulsion energy sum c / d between
+	 * point @p i and all other points, with respect to the position of i.
+	 * @param i the point to compute the derivatives at
+	 * @param c the strength of the repulsion
+	 * @param result where to store the sums
+	 */
+	void repulsion( int i, qreal c, KKDerivatives *result ) const;
+
+	/**
+	 * Finds the points inside a rectangle, borders included, without
+	 * walking the cells outside of it
+	 * @param limit the most points wanted
+	 * @param result the points are appended to this, in no particular order
+	 * @return false, with @p result incomplete, if there are more than
+	 * @p limit points inside
+	 */
+	bool points( const QRectF &rect, int limit, QVector<int> *result ) const;
+
+private:
+	struct Cell {
+		qreal cx, cy, half; ///< centre and half the side of the square
+		qreal sx, sy; ///< sum of the positions of the points inside
+		int count; ///< number of points inside
+		int parent;
+		int child; ///< index of the first of four children, -1 for a leaf
+		int depth;
+		QVector<int> points; ///< the points in a leaf
+	};
+
+	int newCell( int parent, qreal cx, qreal cy, qreal half, int depth );
+	/** @return the child of cell @p c containing @p x, @p y */
+	inline int childFor( int c, qreal x, qreal y ) const;
+	void insert( int i );
+	void split( int c );
+	void addMass( int c, qreal x, qreal y, int count );
+
+	QVector<Cell> m_cells;
+	QVector<qreal> m_x;
+	QVector<qreal> m_y;
+	QVector<int> m_leaf; ///< the leaf each point is in
+	qreal m_theta;
+};
+
+#endif //include guard
@@ -0,0 +1,52 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "RandomGenerator.h"
+
+/* This is splitmix64, which passes BigCrush and is far more than enough
+ * for picking positions and shuffling vertices */
+
+RandomGenerator::RandomGenerator( quint64 seed )
+{
+	m_state = seed;
+}
+
+void RandomGenerator::seed( quint64 seed )
+{
+	m_state = seed;
+}
+
+quint64 RandomGenerator::state() const
+{
+	return m_state;
+}
+
+void RandomGenerator::setState( quint64 state )
+{
+	m_state = state;
+}
+
+quint32 RandomGenerator::next()
+{
+	m_state += Q_UINT64_C(0x9E3779B97F4A7C15);
+	quint64 z = m_state;
+	z = ( z ^ ( z >> 30 ) ) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+	z = ( z ^ ( z >> 27 ) ) * Q_UINT64_C(0x94D049BB133111EB);
+	return (quint32)( ( z ^ ( z >> 31 ) ) >> 32 );
+}
+
+qreal RandomGenerator::uniform()
+{
+	return next() / 4294967296.0;
+}
+
+int RandomGenerator::below( int n )
+{
+	return (int)( uniform() * n );
+}
@@ -0,0 +1,44 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef RANDOMGENERATOR_H
+#define RANDOMGENERATOR_H
+
+#include <QtCore/QtGlobal>
+
+/**
+ * @brief A small seedable random number generator for the layouts
+ *
+ * Unlike rand() and drand48() the whole state is one number that can be
+ * saved and restored, and every graph has its own, so a layout started
+ * from the same seed produces the same result on every platform.
+ */
+class RandomGenerator
+{
+public:
+	RandomGenerator( quint64 seed = 21184 );
+
+	/** restarts the sequence from @p seed */
+	void seed( quint64 seed );
+
+	/** @return the current state, to be given to setState() later */
+	quint64 state() const;
+	/** continues the sequence from a state returned by state() */
+	void setState( quint64 state );
+
+	/** @return the next 32 random bits */
+	quint32 next();
+	/** @return a uniformly distributed number in [0,1) */
+	qreal uniform();
+	/** @return a uniformly distributed integer in [0,n) */
+	int below( int n );
+private:
+	quint64 m_state;
+};
+
+#endif //include guard
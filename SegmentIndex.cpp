@@ -0,0 +1,141 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "SegmentIndex.h"
+
+//math
+#include <cmath>
+
+#include "GraphCore.h"
+
+// the finest level has about this many edges per cell
+static const int EDGESPERCELL = 2;
+// the finest level has at most this many cells per side
+static const int MAXSIDE = 1024;
+
+SegmentIndex::SegmentIndex()
+{
+	m_left = 0.0;
+	m_top = 0.0;
+	m_built = false;
+}
+
+void SegmentIndex::clear()
+{
+	m_levels.clear();
+	m_built = false;
+}
+
+bool SegmentIndex::isEmpty() const
+{
+	return !m_built;
+}
+
+inline int SegmentIndex::cellOf( const Level &level, qreal v,
+                                 qreal origin ) const
+{
+	int c = (int)floor( ( v - origin ) / level.cell );
+	return qBound( 0, c, level.side - 1 );
+}
+
+void SegmentIndex::build( const GraphCore *core )
+{
+	m_levels.clear();
+	m_built = true;
+	int n = core->size();
+	int m = core->edgeCount();
+	if( n == 0 || m == 0 )
+		return;
+
+	const qreal *x = core->xs().constData();
+	const qreal *y = core->ys().constData();
+	qreal right = x[0], bottom = y[0];
+	m_left = x[0];
+	m_top = y[0];
+	for(int i = 1; i < n; ++i) {
+		m_left = qMin( m_left, x[i] );
+		right = qMax( right, x[i] );
+		m_top = qMin( m_top, y[i] );
+		bottom = qMax( bottom, y[i] );
+	}
+	qreal size = qMax( right - m_left, bottom - m_top );
+	if( size <= 0.0 )
+		size = 1.0;
+
+	int side = 1;
+	while( side < MAXSIDE && side * side * EDGESPERCELL < m )
+		side *= 2;
+	for(; side >= 1; side /= 2) {
+		Level level;
+		level.side = side;
+		level.cell = size / side;
+		m_levels.append( level );
+	}
+
+	//the level and cell of every edge, then a counting sort by them
+	QVector<int> levels( m );
+	QVector<int> cells( m );
+	for(int e = 0; e < m; ++e) {
+		int a = core->head( e ), b = core->tail( e );
+		qreal extent = qMax( qAbs( x[b] - x[a] ), qAbs( y[b] - y[a] ) );
+		int l = 0;
+		while( l < m_levels.size() - 1 && m_levels.at(l).cell < extent )
+			++l;
+		const Level &level = m_levels.at(l);
+		levels[e] = l;
+		cells[e] = cellOf( level, qMin( y[a], y[b] ), m_top ) * level.side
+		           + cellOf( level, qMin( x[a], x[b] ), m_left );
+	}
+	for(int l = 0; l < m_levels.size(); ++l) {
+		Level &level = m_levels[l];
+		level.offsets = QVector<int>( level.side * level.side + 1, 0 );
+	}
+	for(int e = 0; e < m; ++e)
+		++m_levels[ levels.at(e) ].offsets[ cells.at(e) + 1 ];
+	for(int l = 0; l < m_levels.size(); ++l) {
+		Level &level = m_levels[l];
+		for(int c = 1; c < level.offsets.size(); ++c)
+			level.offsets[c] += level.offsets.at(c - 1);
+		level.edges = QVector<int>( level.offsets.last() );
+	}
+	QVector< QVector<int> > next( m_levels.size() );
+	for(int l = 0; l < m_levels.size(); ++l)
+		next[l] = m_levels.at(l).offsets;
+	for(int e = 0; e < m; ++e) {
+		int l = levels.at(e);
+		m_levels[l].edges[ next[l][ cells.at(e) ]++ ] = e;
+	}
+}
+
+void SegmentIndex::segments( const QRectF &rect, QVector<int> *result ) const
+{
+	for(int l = 0; l < m_levels.size(); ++l) {
+		const Level &level = m_levels.at(l);
+		if( level.edges.isEmpty() )
+			continue;
+		//an edge reaches at most one cell right and down of its own
+		qreal x0 = floor( ( rect.left() - m_left ) / level.cell ) - 1.0;
+		qreal x1 = floor( ( rect.right() - m_left ) / level.cell );
+		qreal y0 = floor( ( rect.top() - m_top ) / level.cell ) - 1.0;
+		qreal y1 = floor( ( rect.bottom() - m_top ) / level.cell );
+		if( x1 < 0.0 || y1 < 0.0 || x0 >= level.side || y0 >= level.side )
+			continue;
+		int left = (int)qMax( (qreal)0.0, x0 );
+		int right = (int)qMin( (qreal)( level.side - 1 ), x1 );
+		int top = (int)qMax( (qreal)0.0, y0 );
+		int bottom = (int)qMin( (qreal)( level.side - 1 ), y1 );
+		//the cells of a row are next to each other, and so their edges
+		for(int row = top; row <= bottom; ++row) {
+			int begin = level.offsets.at( row * level.side + left );
+			int end = level.offsets.at( row * level.side + right + 1 );
+			for(int k = begin; k < end; ++k)
+				result->append( level.edges.at(k) );
+		}
+	}
+}
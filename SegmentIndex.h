@@ -0,0 +1,66 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef SEGMENTINDEX_H
+#define SEGMENTINDEX_H
+
+#include <QtCore/QRectF>
+#include <QtCore/QVector>
+
+class GraphCore;
+
+/**
+ * @brief Finds the edges of a graph near a rectangle
+ *
+ * The edges are kept as straight segments in a stack of grids over the
+ * vertices, each level with cells twice as large as the one below. An
+ * edge goes into the finest level whose cells are at least as large as
+ * it is, in the cell holding the top left corner of its bounding box, so
+ * it reaches at most one cell further right and down. A query walks only
+ * the cells of each level that such an edge could reach the rectangle
+ * from, and the edges of a row of cells are contiguous in memory.
+ *
+ * Building is O(n + m) and needs no sorting; a query costs the edges
+ * returned plus a row of cells per level and grid line crossed.
+ */
+class SegmentIndex
+{
+public:
+	SegmentIndex();
+
+	/** Indexes the edges of @p core at its current positions */
+	void build( const GraphCore *core );
+	/** throws the index away */
+	void clear();
+	/** @return true if build() has not been called since clear() */
+	bool isEmpty() const;
+
+	/**
+	 * Appends to @p result the edges whose bounding box may meet @p rect.
+	 * Every edge that does meet it is returned, plus some close to it.
+	 */
+	void segments( const QRectF &rect, QVector<int> *result ) const;
+
+private:
+	struct Level {
+		int side; ///< the number of cells per side
+		qreal cell; ///< the size of a cell
+		QVector<int> offsets; ///< side² + 1 offsets into edges
+		QVector<int> edges; ///< the edges, cell by cell in row order
+	};
+
+	/** @return the cell of coordinate @p v along one side of @p level */
+	inline int cellOf( const Level &level, qreal v, qreal origin ) const;
+
+	QVector<Level> m_levels;
+	qreal m_left;
+	qreal m_top;
+	bool m_built;
+};
+
+#endif //include guard
@@ -0,0 +1,233 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "StressLayout.h"
+
+//math
+#include <cmath>
+
+// C++ std lib for sorting the pivot regions
+#include <algorithm>
+
+#include "Graph.h"
+#include "DistanceMatrix.h"
+#include "RandomGenerator.h"
+
+// graphs larger than this use pivots unless told otherwise
+static const int SPARSELIMIT = 2048;
+// the number of pivots used by default, as in Zheng et al.
+static const int DEFAULTPIVOTS = 200;
+// the last epoch moves the stiffest pair by this fraction of its error
+static const qreal FINALSTEP = 0.1;
+
+StressLayout::StressLayout( Graph *g, RandomGenerator *random, int pivots )
+{
+	m_random = random;
+	m_graph = g;
+	m_x = g->core()->xs();
+	m_y = g->core()->ys();
+	int n = m_x.size();
+
+	if( pivots < 0 )
+		pivots = n > SPARSELIMIT ? DEFAULTPIVOTS : 0;
+	m_sparse = pivots > 0 && pivots < n;
+	//past the size of a distance matrix all pairs can't be had
+	if( !m_sparse && !g->distances().isValid() ) {
+		pivots = DEFAULTPIVOTS;
+		m_sparse = true;
+	}
+	if( m_sparse )
+		addPivots( g, pivots );
+	else
+		addAllPairs( g );
+}
+
+int StressLayout::size() const
+{
+	return m_x.size();
+}
+
+bool StressLayout::isSparse() const
+{
+	return m_sparse;
+}
+
+void StressLayout::addAllPairs( Graph *g )
+{
+	const DistanceMatrix &distances = g->distances();
+	int n = distances.size();
+	QVector<qreal> scratch( n );
+	for(int i = 0; i < n; ++i) {
+		const qreal *row = distances.row( i, scratch.data() );
+		for(int j = i + 1; j < n; ++j) {
+			qreal d = row[j] * EDGELENGTH;
+			if( d <= 0.0 )
+				continue;
+			Term t;
+			t.i = i;
+			t.j = j;
+			t.d = d;
+			t.w = 1.0 / ( d * d );
+			t.both = true;
+			m_terms.append( t );
+		}
+	}
+}
+
+void StressLayout::addPivots( Graph *g, int pivots )
+{
+	DistanceMatrix::Adjacency adjacency = g->core()->adjacency();
+	int n = adjacency.size();
+
+	//max/min pivots: each one is the vertex farthest from all before it,
+	//and every vertex belongs to the region of the pivot closest to it
+	QVector<int> pivot;
+	QVector< QVector<float> > distance;
+	QVector<int> region( n, -1 );
+	QVector<qreal> nearest( n, 0.0 );
+	qreal diameter = 0.0;
+	int p = m_random->below( n );
+	while( pivot.size() < pivots ) {
+		int k = pivot.size();
+		QVector<qreal> dist = DistanceMatrix::shortestPaths( adjacency, p );
+		QVector<float> row( n );
+		for(int j = 0; j < n; ++j) {
+			row[j] = dist.at(j);
+			if( dist.at(j) < 0.0 )
+				continue;
+			diameter = qMax( diameter, dist.at(j) );
+			if( region.at(j) < 0 || dist.at(j) < nearest.at(j) ) {
+				region[j] = k;
+				nearest[j] = dist.at(j);
+			}
+		}
+		pivot.append( p );
+		distance.append( row );
+
+		//vertices in no region yet are in another component, go there first
+		int farthest = -1;
+		for(int j = 0; j < n; ++j) {
+			if( region.at(j) < 0 ) {
+				farthest = j;
+				break;
+			}
+			if( farthest < 0 || nearest.at(j) > nearest.at(farthest) )
+				farthest = j;
+		}
+		if( region.at(farthest) >= 0 && nearest.at(farthest) == 0.0 )
+			break; //every vertex is a pivot
+		p = farthest;
+	}
+
+	QVector< QVector<float> > members( pivot.size() );
+	for(int j = 0; j < n; ++j)
+		if( region.at(j) >= 0 )
+			members[ region.at(j) ].append( nearest.at(j) );
+	for(int k = 0; k < members.size(); ++k)
+		std::sort( members[k].data(), members[k].data() + members[k].size() );
+
+	//the edges themselves, with both ends moving
+	for(int i = 0; i < n; ++i) {
+		const QVector< QPair<int,qreal> > &adjacent = adjacency.at(i);
+		for(int k = 0; k < adjacent.size(); ++k) {
+			if( adjacent.at(k).first <= i )
+				continue;
+			Term t;
+			t.i = i;
+			t.j = adjacent.at(k).first;
+			t.d = adjacent.at(k).second * EDGELENGTH;
+			t.w = 1.0 / ( t.d * t.d );
+			t.both = true;
+			m_terms.append( t );
+		}
+	}
+
+	//a pivot pulls a vertex i with the weight of all vertices of its region
+	//that are no farther than half way to i, only i moves
+	QVector<int> marker( n, -1 );
+	for(int k = 0; k < pivot.size(); ++k) {
+		p = pivot.at(k);
+		const QVector< QPair<int,qreal> > &adjacent = adjacency.at(p);
+		for(int j = 0; j < adjacent.size(); ++j)
+			marker[ adjacent.at(j).first ] = k;
+		const float *begin = members.at(k).constData();
+		const float *end = begin + members.at(k).size();
+		for(int i = 0; i < n; ++i) {
+			if( i == p || marker.at(i) == k )
+				continue;
+			qreal d = distance.at(k).at(i);
+			int s = 1;
+			if( d < 0.0 ) {
+				d = diameter + 1.0;
+			} else {
+				const float *half = std::upper_bound( begin, end, (float)( d / 2 ) );
+				s = qMax( 1, (int)( half - begin ) );
+			}
+			Term t;
+			t.i = i;
+			t.j = p;
+			t.d = d * EDGELENGTH;
+			t.w = s / ( t.d * t.d );
+			t.both = false;
+			m_terms.append( t );
+		}
+	}
+}
+
+void StressLayout::epoch( qreal eta )
+{
+	int count = m_terms.size();
+	for(int k = count - 1; k > 0; --k)
+		qSwap( m_terms[k], m_terms[ m_random->below( k + 1 ) ] );
+
+	qreal *x = m_x.data();
+	qreal *y = m_y.data();
+	for(int k = 0; k < count; ++k) {
+		const Term &t = m_terms.at(k);
+		qreal dx = x[t.i] - x[t.j];
+		qreal dy = y[t.i] - y[t.j];
+		qreal mag = sqrt( dx*dx + dy*dy );
+		if( mag == 0.0 )
+			continue;
+		//moving by mu times the error at most puts the pair at distance d
+		qreal mu = qMin( (qreal)( t.w * eta ), (qreal)1.0 );
+		qreal r = mu * ( mag - t.d ) / mag;
+		if( t.both ) {
+			r /= 2;
+			x[t.j] += r * dx;
+			y[t.j] += r * dy;
+		}
+		x[t.i] -= r * dx;
+		y[t.i] -= r * dy;
+	}
+}
+
+void StressLayout::run( int epochs )
+{
+	if( m_terms.isEmpty() || epochs <= 0 )
+		return;
+	qreal wmin = m_terms.at(0).w, wmax = m_terms.at(0).w;
+	for(int k = 1; k < m_terms.size(); ++k) {
+		wmin = qMin( wmin, (qreal)m_terms.at(k).w );
+		wmax = qMax( wmax, (qreal)m_terms.at(k).w );
+	}
+	//the first epoch lets even the weakest pair reach its ideal distance,
+	//the last one only moves the strongest by FINALSTEP of its error
+	qreal etaMax = 1.0 / wmin;
+	qreal etaMin = FINALSTEP / wmax;
+	qreal lambda = epochs > 1 ? log( etaMax / etaMin ) / ( epochs - 1 ) : 0.0;
+	for(int t = 0; t < epochs; ++t)
+		epoch( etaMax * exp( -lambda * t ) );
+}
+
+void StressLayout::apply()
+{
+	m_graph->core()->setPositions( m_x, m_y );
+	m_graph->updateItems();
+}
@@ -0,0 +1,80 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef STRESSLAYOUT_H
+#define STRESSLAYOUT_H
+
+#include <QtCore/QVector>
+
+class Graph;
+class RandomGenerator;
+
+/**
+ * @brief Minimizes the Kamada-Kawai stress by stochastic gradient descent
+ *
+ * The stress is the spring part of the Kamada-Kawai energy, the sum of
+ * (|x_i - x_j| - d_ij)² / d_ij² over all pairs. Instead of moving one
+ * vertex per iteration, every epoch visits all pairs in a random order and
+ * moves both ends of each pair straight towards their ideal distance, by a
+ * step that shrinks exponentially from epoch to epoch. See Zheng, Pawar
+ * and Goodman, "Graph drawing by stochastic gradient descent", 2018.
+ *
+ * For large graphs the n² pairs are replaced by the edges plus the pairs
+ * between each vertex and a set of pivots, weighted by how many vertices
+ * the pivot stands in for. That only needs one shortest path search per
+ * pivot instead of the whole distance matrix.
+ */
+class StressLayout
+{
+public:
+	/**
+	 * Sets up the pairs to visit
+	 * @param g the graph to lay out, it is read but not changed
+	 * @param random the source of the order of the pairs
+	 * @param pivots the number of pivots, 0 for all pairs and -1 to use
+	 * all pairs for small graphs and pivots for large ones. Graphs too
+	 * large for Graph::distances() always use pivots.
+	 */
+	StressLayout( Graph *g, RandomGenerator *random, int pivots = -1 );
+
+	/** @return the number of vertices */
+	int size() const;
+	/** @return true if pivots stand in for most of the pairs */
+	bool isSparse() const;
+
+	/**
+	 * Runs @p epochs epochs, annealing the step from one that moves every
+	 * pair fully to its ideal distance down to a small fraction of that
+	 */
+	void run( int epochs );
+
+	/** Writes the positions back to the vertices */
+	void apply();
+
+private:
+	/// a pair of vertices that pull or push each other
+	struct Term {
+		int i, j;
+		float d; ///< the ideal distance
+		float w; ///< the weight of the pair in the stress
+		bool both; ///< false if only i moves, j is a pivot
+	};
+
+	void addAllPairs( Graph *g );
+	void addPivots( Graph *g, int pivots );
+	void epoch( qreal eta );
+
+	Graph *m_graph;
+	QVector<qreal> m_x;
+	QVector<qreal> m_y;
+	QVector<Term> m_terms;
+	RandomGenerator *m_random;
+	bool m_sparse;
+};
+
+#endif //include guard
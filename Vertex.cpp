@@ -12,8 +12,8 @@
 // Qt
 #include <QtGui/QGraphicsRectItem>
 #include <QtGui/QPainter>
+#include <QtGui/QStyleOptionGraphicsItem>
 #include <QtGui/QFont>
-#include <QtGui/QFontMetrics>
 #include <QtGui/QPen>
 #include <QtGui/QBrush>
 #include <QtGui/QColor>
@@ -21,57 +21,69 @@
 #include <QtCore/QPointF>
 #include <QtCore/QRectF>
 #include <QtCore/QSizeF>
-#include <QtCore/QMap>
+#include <QtCore/QVector>
 #include <QtCore/QString>
 #include <QtCore/QDebug>
 
-//C std lib for rand()
-#include <stdlib.h>
-
 // other graphs
 #include "Graph.h"
 #include "Edge.h"
+#include "EdgeLayer.h"
+#include "ItemArena.h"
+#include "LabelMetrics.h"
 
 static const QPen VERTEXPEN(QBrush(QColor(Qt::black)), 0.5);
 static const QBrush VERTEXBRUSH( QColor( 0xFF, 0xFF, 0xFF, 0x80 ) );
 static const QFont VERTEXFONT( "Helvetica", 12, QFont::Normal );
+// vertices smaller than this many pixels are drawn as dots
+static const qreal DOTPIXELS = 3.0;
+// labels shorter than this many pixels are not drawn
+static const qreal LABELPIXELS = 6.0;
 
 Vertex::Vertex(Graph *g, uint id, QString text, QPointF nodePos,
-               QGraphicsItem *parent) 
+               QGraphicsItem *parent, bool literalId)
       : QGraphicsRectItem(parent)
 {
 	m_g = g;
 	m_text = text;
-	if( id == 0 )
-		for(;;) {
-			id = (uint)(rand());
-			if( m_g->isValidNewId(id) )
-			break;
-		}
+	if( id == 0 && !literalId )
+		id = m_g->newId();
 	m_id = id;
-
-	m_edges = QList<Edge*>();
-	m_adjacent = QMap<uint,Vertex*>();
-
-	m_nodePos = nodePos;
+	m_index = -1;
 
 	setPen  ( VERTEXPEN );
 	setBrush( VERTEXBRUSH );
 
 	//find the size & position of the vertex
-	QFontMetrics m( VERTEXFONT );
-	QRect r = m.boundingRect(m_text);
-	//qDebug() << "font metrics for text:";
-	//qDebug() << m_text;
-	//qDebug() << "suggest rect: " << r << ", size: " << r.size();
-	// adjust for the fact that nodePos is the centre of the rect
-	setRect( QRectF( m_nodePos - QPointF( r.width()/2, r.height()/2 ),
-	         QSizeF( r.size() ) ) );
-	//qDebug() << "set rect: " << rect() << ", size: " << rect().size();
+	setRectAround( nodePos, boxSize( m_text ) );
 
 	setZValue(2.0);
 
-	m_g->vertexAdded( this );
+	m_g->vertexAdded( this, nodePos );
+}
+
+/* The graph unlinks the vertex itself when it goes first */
+Vertex::~Vertex()
+{
+	if( m_index >= 0 )
+		m_g->vertexRemoved( this );
+}
+
+void* Vertex::operator new( size_t size, Graph *g )
+{
+	return g->vertexArena()->allocate( size );
+}
+
+/* Only called if the constructor throws */
+void Vertex::operator delete( void *p, Graph *g )
+{
+	Q_UNUSED( g );
+	ItemArena::release( p );
+}
+
+void Vertex::operator delete( void *p )
+{
+	ItemArena::release( p );
 }
 
 uint Vertex::id() const
@@ -81,7 +93,17 @@ uint Vertex::id() const
 
 int Vertex::degree() const
 {
-	return m_edges.size();
+	return m_g->core()->degree( m_index );
+}
+
+int Vertex::index() const
+{
+	return m_index;
+}
+
+void Vertex::setIndex( int index )
+{
+	m_index = index;
 }
 
 QString Vertex::text() const
@@ -93,78 +115,137 @@ void Vertex::setText( const QString &text )
 {
 	m_text = text;
 	//find the size & position of the vertex
-	QFontMetrics m( VERTEXFONT );
-	QRect r = m.boundingRect(m_text);
-	//qDebug() << "font metrics for text:";
-	//qDebug() << m_text;
-	//qDebug() << "suggest rect: " << r << ", size: " << r.size();
-	// adjust for the fact that nodePos is the centre of the rect
-	setRect( QRectF( m_nodePos - QPointF( r.width()/2, r.height()/2 ),
-	         QSizeF( r.size() ) ) );
-	//qDebug() << "set rect: " << rect() << ", size: " << rect().size();
+	setRectAround( nodePos(), boxSize( m_text ) );
 }
 
-QMap<uint,Vertex*> Vertex::adjacent() const
+QVector<Vertex*> Vertex::adjacent() const
 {
-	return m_adjacent;
+	const GraphCore *core = m_g->core();
+	const int *offsets = core->offsets();
+	const int *neighbours = core->neighbours();
+	QVector<Vertex*> adjacent;
+	adjacent.reserve( offsets[m_index+1] - offsets[m_index] );
+	for(int k = offsets[m_index]; k < offsets[m_index+1]; ++k)
+		adjacent.append( m_g->vertexAt( neighbours[k] ) );
+	return adjacent;
 }
 
 QList<Edge*> Vertex::edges() const
 {
-	return m_edges;
+	QList<Edge*> edges;
+	const GraphCore *core = m_g->core();
+	const int *offsets = core->offsets();
+	const int *neighbours = core->neighbours();
+	const int *e = core->edges();
+	for(int k = offsets[m_index]; k < offsets[m_index+1]; ++k)
+		if( !isRepeatedLoop( offsets[m_index], k, neighbours, e ) )
+			edges.append( m_g->edgeAt( e[k] ) );
+	return edges;
+}
+
+/* A loop is in the row twice, at entries that name the vertex itself.
+ * Loops are rare, so only those entries look back along the row. */
+bool Vertex::isRepeatedLoop( int begin, int k, const int *neighbours,
+                             const int *edges ) const
+{
+	if( neighbours[k] != m_index )
+		return false;
+	for(int j = begin; j < k; ++j)
+		if( edges[j] == edges[k] )
+			return true;
+	return false;
 }
 
 Edge* Vertex::createEdge( Vertex *tail, qreal weight )
 {
-	Edge *e = new Edge( m_g, this, tail, weight, parentItem() );
+	Edge *e = new( m_g ) Edge( m_g, this, tail, weight, parentItem() );
 	return e;
 }
 
 QPointF Vertex::nodePos() const
 {
-	return m_nodePos;
+	const GraphCore *core = m_g->core();
+	return QPointF( core->x( m_index ), core->y( m_index ) );
 }
 
 void Vertex::setNodePos( QPointF pos )
 {
-	m_nodePos = pos;
-	// adjust for the fact that nodePos is the centre of the rect
-	setRect( QRectF( m_nodePos - QPointF(rect().width()/2, rect().height()/2),
-	         rect().size() ) );
-	for(QList<Edge*>::const_iterator i = m_edges.constBegin();
-	    i != m_edges.constEnd(); ++i )
-	{
-		(*i)->updatePos();
-	}
+	m_g->core()->setPosition( m_index, pos.x(), pos.y() );
+	if( m_g->isInTransaction() )
+		return;
+	setRectAround( pos, rect().size() );
+	//straight off the row, a loop is just updated twice
+	const GraphCore *core = m_g->core();
+	const int *offsets = core->offsets();
+	const int *e = core->edges();
+	for(int k = offsets[m_index]; k < offsets[m_index+1]; ++k)
+		m_g->edgeAt( e[k] )->updatePos();
+	if( m_g->edgeLayer() )
+		m_g->edgeLayer()->positionsChanged();
+}
+
+void Vertex::updatePos()
+{
+	setRectAround( nodePos(), rect().size() );
 }
 
-void Vertex::addEdge(Edge *e)
+bool Vertex::isMoved() const
 {
-	m_edges.append(e);
-	if(e->head() == this)
-		m_adjacent.insert(e->tail()->id(), e->tail());
-	else
-		m_adjacent.insert(e->head()->id(), e->head());
+	return m_shownPos != nodePos();
 }
 
-void Vertex::removeEdge(Edge *e)
+/* This is because the graphicitem's pos is at 0,0 but the position of
+ * the node should be in the centre of the rect, not the corner */
+void Vertex::setRectAround( QPointF pos, QSizeF size )
 {
-	m_edges.removeAll(e);
-	if(e->head() == this)
-		m_adjacent.remove(e->tail()->id());
-	else
-		m_adjacent.remove(e->head()->id());
+	m_shownPos = pos;
+	setRect( QRectF( pos - QPointF( size.width()/2, size.height()/2 ), size ) );
 }
 
 void Vertex::paint( QPainter *painter,
                     const QStyleOptionGraphicsItem *option,
                     QWidget *widget )
 {
-	painter->setPen( pen() );
-	painter->setBrush( brush() );
-	painter->setFont( VERTEXFONT );
+	Q_UNUSED( option );
+	Q_UNUSED( widget );
+	paintBox( painter, rect(), m_text, pen(), brush() );
+}
+
+QSizeF Vertex::boxSize( const QString &text )
+{
+	return labelMetrics()->size( text );
+}
 
-	painter->drawRect(rect());
+LabelMetrics* Vertex::labelMetrics()
+{
+	return LabelMetrics::forFont( VERTEXFONT );
+}
+
+void Vertex::paintBox( QPainter *painter, const QRectF &r,
+                       const QString &text, const QPen &pen,
+                       const QBrush &brush )
+{
+	qreal lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+	                painter->worldTransform() );
+	//far out a vertex is a dot, and its outline and text can't be seen
+	if( lod * qMax( r.width(), r.height() ) < DOTPIXELS ) {
+		painter->fillRect( r, pen.color() );
+		return;
+	}
+
+	painter->setPen( pen );
+	painter->setBrush( brush );
+	painter->drawRect( r );
 
-	painter->drawText(rect(), Qt::AlignCenter, m_text);
-}
\ No newline at end of file
+	//the rect is as high as the text
+	if( text.isEmpty() || lod * r.height() < LABELPIXELS )
+		return;
+	painter->setFont( VERTEXFONT );
+	painter->drawText( r, Qt::AlignCenter, text );
+}
+
+void Vertex::paintBox( QPainter *painter, const QRectF &r,
+                       const QString &text )
+{
+	paintBox( painter, r, text, VERTEXPEN, VERTEXBRUSH );
+}
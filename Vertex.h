@@ -11,51 +11,117 @@
 
 #include <QtGui/QGraphicsRectItem>
 #include <QtCore/QList>
-#include <QtCore/QMap>
+#include <QtCore/QVector>
 #include <QtCore/QString>
 
+class QBrush;
 class QPainter;
+class QPen;
 class QStyleOptionGraphicsItem;
 class QWidget;
 
 class Graph;
 class Edge;
+class LabelMetrics;
 
+/**
+ * The graphics item of a vertex. The position and the edges are kept in
+ * the GraphCore of the graph, this only draws them.
+ */
 class Vertex : public QGraphicsRectItem
 {
 public:
+	/**
+	 * @param id the id of the vertex, 0 for a new one from Graph::newId()
+	 * @param literalId true to keep an id of 0 as it is, for vertices
+	 * that come from a file
+	 */
 	Vertex(Graph *g, uint id = 0, QString text = QString(),
-	       QPointF nodePos = QPointF(), QGraphicsItem *parent = 0);
+	       QPointF nodePos = QPointF(), QGraphicsItem *parent = 0,
+	       bool literalId = false);
+	/** Takes the vertex out of its graph and deletes its edges */
+	~Vertex();
+
+	/**
+	 * Vertices live in the ItemArena of their graph, make them with
+	 * new( g ) Vertex( g, ... ). They may be deleted like any other item,
+	 * by their scene or parent item too, while the graph exists.
+	 */
+	static void* operator new( size_t size, Graph *g );
+	static void operator delete( void *p, Graph *g );
+	static void operator delete( void *p );
 
 	Edge* createEdge( Vertex *tail, qreal weight = 1.0 );
 	QList<Edge*> edges() const;
 
-	QMap<uint,Vertex*> adjacent() const;
+	/**
+	 * @return the neighbours, straight from the row of the vertex in the
+	 * GraphCore: one entry per edge end, so a loop gives the vertex twice
+	 */
+	QVector<Vertex*> adjacent() const;
 
 	uint id() const;
 	int degree() const;
 
+	/** @return the index of the vertex in the GraphCore of its graph */
+	int index() const;
+	/** used by the graph when the index changes */
+	void setIndex( int index );
+
 	QString text() const;
 	void setText( const QString &text );
 
 	/* This is because the graphicitem's pos is at 0,0 but the position of
 	 * the node should be in the centre of the rect, not the corner */
 	QPointF nodePos() const;
+	/**
+	 * Moves the vertex. Inside a Graph::beginTransaction() only the
+	 * position in the graph changes, the item follows on commit.
+	 */
 	void setNodePos( QPointF pos );
+	/** Moves the item to the position kept in the graph */
+	void updatePos();
+	/** @return true if the item isn't at the position kept in the graph */
+	bool isMoved() const;
 
-	void addEdge(Edge *e);
-	void removeEdge(Edge *e);
-
+	/**
+	 * Draws the box and the text. Zoomed out, the text is left out once it
+	 * is too small to read, and the box becomes a dot once it is a few
+	 * pixels big.
+	 */
 	virtual void paint( QPainter *painter,
 	                    const QStyleOptionGraphicsItem *option,
 	                    QWidget *widget = 0 );
+
+	/**
+	 * @return the size of the box of a vertex with the text @p text. Each
+	 * text is only measured once.
+	 */
+	static QSizeF boxSize( const QString &text );
+	/** @return the cache of the sizes of vertex texts */
+	static LabelMetrics* labelMetrics();
+	/**
+	 * Draws the box of a vertex in @p r, with the level of detail of
+	 * paint(), for items that draw vertices without being one
+	 */
+	static void paintBox( QPainter *painter, const QRectF &r,
+	                      const QString &text, const QPen &pen,
+	                      const QBrush &brush );
+	/** Draws the box with the pen and brush of a new vertex */
+	static void paintBox( QPainter *painter, const QRectF &r,
+	                      const QString &text );
 private:
+	void setRectAround( QPointF pos, QSizeF size );
+	/** @return true if row entry @p k is the second end of a loop */
+	bool isRepeatedLoop( int begin, int k, const int *neighbours,
+	                     const int *edges ) const;
+
 	Graph *m_g;
-	QList<Edge*> m_edges;
-	QMap<uint,Vertex*> m_adjacent;
-	QPointF m_nodePos;
 	QString m_text;
 	uint m_id;
+	int m_index;
+	/// where the item was last put
+	QPointF m_shownPos;
 };
 #endif //include guard
 
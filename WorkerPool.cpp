@@ -0,0 +1,180 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+// own
+#include "WorkerPool.h"
+
+// QtCore
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+// parts smaller than this cost more to hand out than to run
+static const int MINPARTSIZE = 1024;
+
+class WorkerThread : public QThread
+{
+public:
+	WorkerThread( WorkerPool *pool, int part )
+	    : m_pool( pool ), m_part( part ) {}
+protected:
+	void run()
+	{
+		m_pool->work( m_part );
+	}
+private:
+	WorkerPool *m_pool;
+	int m_part;
+};
+
+WorkerPool::WorkerPool( int threads )
+{
+	if( threads <= 0 )
+		threads = QThread::idealThreadCount();
+	m_threadCount = qMax( 1, threads );
+	m_task = 0;
+	m_n = 0;
+	m_parts = 0;
+	m_pending = 0;
+	m_each = false;
+	m_next = 0;
+	m_generation = 0;
+	m_quit = false;
+
+	//part 0 is always done by the thread calling run()
+	for(int part = 1; part < m_threadCount; ++part) {
+		QThread *t = new WorkerThread( this, part );
+		m_threads.append( t );
+		t->start();
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	m_mutex.lock();
+	m_quit = true;
+	m_start.wakeAll();
+	m_mutex.unlock();
+	for(int i = 0; i < m_threads.size(); ++i) {
+		m_threads.at(i)->wait();
+		delete m_threads.at(i);
+	}
+}
+
+int WorkerPool::threadCount() const
+{
+	return m_threadCount;
+}
+
+int WorkerPool::parts( int n ) const
+{
+	return qMax( 1, qMin( m_threadCount, n / MINPARTSIZE ) );
+}
+
+void WorkerPool::run( ParallelTask *task, int n )
+{
+	int parts = this->parts( n );
+	if( parts == 1 ) {
+		task->run( 0, 0, n );
+		return;
+	}
+
+	m_mutex.lock();
+	m_task = task;
+	m_n = n;
+	m_parts = parts;
+	m_pending = parts - 1;
+	++m_generation;
+	m_start.wakeAll();
+	m_mutex.unlock();
+
+	task->run( 0, 0, (int)( (qint64)n / parts ) );
+
+	QMutexLocker locker( &m_mutex );
+	while( m_pending > 0 )
+		m_done.wait( &m_mutex );
+	m_task = 0;
+}
+
+void WorkerPool::runEach( ParallelTask *task, int n )
+{
+	int parts = qMin( m_threadCount, n );
+	if( parts <= 1 ) {
+		for(int i = 0; i < n; ++i)
+			task->run( 0, i, i + 1 );
+		return;
+	}
+
+	m_mutex.lock();
+	m_task = task;
+	m_n = n;
+	m_parts = parts;
+	m_pending = parts - 1;
+	m_each = true;
+	m_next = 0;
+	++m_generation;
+	m_start.wakeAll();
+	m_mutex.unlock();
+
+	runNext( task, 0, n );
+
+	QMutexLocker locker( &m_mutex );
+	while( m_pending > 0 )
+		m_done.wait( &m_mutex );
+	m_task = 0;
+	m_each = false;
+}
+
+/* A lock per index is nothing next to the jobs runEach() is meant for */
+void WorkerPool::runNext( ParallelTask *task, int part, int n )
+{
+	for(;;) {
+		m_mutex.lock();
+		int i = m_next++;
+		m_mutex.unlock();
+		if( i >= n )
+			return;
+		task->run( part, i, i + 1 );
+	}
+}
+
+void WorkerPool::work( int part )
+{
+	uint seen = 0;
+	for(;;) {
+		m_mutex.lock();
+		while( m_generation == seen && !m_quit )
+			m_start.wait( &m_mutex );
+		if( m_quit ) {
+			m_mutex.unlock();
+			return;
+		}
+		seen = m_generation;
+		ParallelTask *task = m_task;
+		int n = m_n;
+		int parts = m_parts;
+		bool each = m_each;
+		m_mutex.unlock();
+
+		//threads past the number of parts sit this one out
+		if( part >= parts )
+			continue;
+
+		if( each ) {
+			runNext( task, part, n );
+		} else {
+			int begin = (int)( (qint64)n * part / parts );
+			int end = (int)( (qint64)n * ( part + 1 ) / parts );
+			task->run( part, begin, end );
+		}
+
+		m_mutex.lock();
+		if( --m_pending == 0 )
+			m_done.wakeAll();
+		m_mutex.unlock();
+	}
+}
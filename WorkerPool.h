@@ -0,0 +1,115 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+class QThread;
+
+/**
+ * A piece of work over an index range that can be split into parts
+ */
+class ParallelTask
+{
+public:
+	virtual ~ParallelTask() {}
+	/**
+	 * Does the work for the indices @p begin <= i < @p end
+	 * @param part the number of the part, 0 <= part < WorkerPool::parts()
+	 */
+	virtual void run( int part, int begin, int end ) = 0;
+};
+
+/**
+ * Adapts a member function of @p T to a ParallelTask
+ */
+template<class T>
+class ParallelMemberTask : public ParallelTask
+{
+public:
+	typedef void (T::*Function)( int part, int begin, int end );
+	ParallelMemberTask( T *object, Function function )
+	    : m_object( object ), m_function( function ) {}
+	void run( int part, int begin, int end )
+	{
+		(m_object->*m_function)( part, begin, end );
+	}
+private:
+	T *m_object;
+	Function m_function;
+};
+
+/**
+ * @brief A fixed set of threads that run sweeps over an index range
+ *
+ * run() cuts [0,n) into contiguous parts, one per thread, and returns when
+ * all of them are done. The parts only depend on n and the thread count,
+ * so a caller that reduces per-part results in part order gets the same
+ * answer every time it uses the same thread count. Small ranges are not
+ * worth waking the threads for and use fewer parts.
+ */
+class WorkerPool
+{
+public:
+	/**
+	 * Starts the threads
+	 * @param threads the number of threads including the calling one,
+	 * 0 means one per core
+	 */
+	WorkerPool( int threads = 0 );
+	/** Stops and joins the threads */
+	~WorkerPool();
+
+	/** @return the number of threads including the calling one */
+	int threadCount() const;
+
+	/** @return the number of parts run() splits a range of @p n into */
+	int parts( int n ) const;
+
+	/**
+	 * Runs @p task on all parts of [0, @p n). The calling thread does part 0
+	 * itself. This must not be called from inside a task.
+	 */
+	void run( ParallelTask *task, int n );
+	/**
+	 * Runs @p task once for every index of [0, @p n), as run( part, i,
+	 * i + 1 ). The threads take the next index whenever they are done with
+	 * one, which suits a few jobs of very different size. The order is not
+	 * fixed, so the task must not depend on which part runs an index.
+	 */
+	void runEach( ParallelTask *task, int n );
+
+private:
+	friend class WorkerThread;
+	void work( int part );
+	void runNext( ParallelTask *task, int part, int n );
+
+	QList<QThread*> m_threads;
+	int m_threadCount;
+
+	QMutex m_mutex;
+	QWaitCondition m_start;
+	QWaitCondition m_done;
+	ParallelTask *m_task;
+	int m_n;
+	int m_parts;
+	int m_pending;
+	/// true while runEach() hands out single indices, the next of them
+	bool m_each;
+	int m_next;
+	uint m_generation;
+	bool m_quit;
+
+	Q_DISABLE_COPY( WorkerPool )
+};
+
+#endif //include guard
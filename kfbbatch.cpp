@@ -0,0 +1,377 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+/*
+ * Lays out many graph files without a display. Every file becomes a
+ * headless Graph, no graphics items are made, and the files are spread
+ * over the threads of a WorkerPool one at a time.
+ */
+
+#include <cstdio>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMap>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+#include <QtCore/QTime>
+#include <QtCore/QVector>
+
+#include "BinaryGraph.h"
+#include "Graph.h"
+#include "GraphCore.h"
+#include "GraphReader.h"
+#include "LayoutQuality.h"
+#include "LayoutTelemetry.h"
+#include "WorkerPool.h"
+
+static const char USAGE[] =
+"usage: kfbbatch [options] FILE...\n"
+"  -a, --algorithm NAME  ngon, random, kamadakawai (default), multilevel,\n"
+"                        stress or fruchtermanreingold\n"
+"  -i, --iterations N    iterations, sweeps or epochs of the algorithm\n"
+"  -e, --epsilon E       stop once the layout changes less than this\n"
+"  -p, --pivots N        pivots of the stress layout, 0 = all pairs\n"
+"  -k, --keep            start from the positions in the file\n"
+"  -s, --seed N          seed of the random numbers\n"
+"  -j, --jobs N          files laid out at once, 0 = one per core (default)\n"
+"  -t, --threads N       threads per layout, 0 = one per core, default 1\n"
+"  -o, --output DIR      where to write the results, default ., as\n"
+"                        NAME.layout.dot; two files with the same NAME\n"
+"                        are refused\n"
+"  -b, --binary          write the binary format instead of text\n"
+"  -q, --quality         report the stress, energy, edge length spread and\n"
+"                        crossings of every layout\n"
+"  -c, --max-crossings N count crossings up to N edges, default 20000\n"
+"  -r, --record          write every iteration of kamadakawai and\n"
+"                        fruchtermanreingold to NAME.telemetry.csv\n";
+
+/// what to do with every file
+struct Settings {
+	Graph::LayoutAlgorithm algorithm;
+	int iterations; ///< -1 for the default of the algorithm
+	qreal epsilon;
+	int pivots;
+	bool initialize;
+	quint64 seed;
+	int threads;
+	QString output;
+	bool binary;
+	bool quality;
+	int maxCrossingEdges;
+	bool record;
+};
+
+/* Writes every sample of a layout as a line of CSV as it comes in */
+class CsvTelemetry : public LayoutTelemetry
+{
+public:
+	CsvTelemetry( QTextStream *out ) : LayoutTelemetry( 1 ), m_out( out ) {}
+
+	static void writeHeader( QTextStream *out )
+	{
+		*out << "iteration,vertex,energy,max_delta,step,evaluations,ns\n";
+	}
+
+protected:
+	void sampled( const LayoutSample &s )
+	{
+		*m_out << s.iteration << "," << s.vertex << "," << s.energy << ","
+		       << s.maxDelta << "," << s.step << "," << s.evaluations << ","
+		       << s.nsecs << "\n";
+	}
+
+private:
+	QTextStream *m_out;
+};
+
+/* @return the path of the results for @p fileName without the suffix */
+static QString outputBase( const Settings &settings, const QString &fileName )
+{
+	return QDir( settings.output ).filePath(
+	           QFileInfo( fileName ).completeBaseName() );
+}
+
+/* Lays out one file per index */
+class BatchTask : public ParallelTask
+{
+public:
+	BatchTask( const Settings &settings, const QStringList &files )
+	    : m_settings( settings ), m_files( files ),
+	      m_reports( files.size() ), m_failed( files.size(), false )
+	{
+	}
+
+	void run( int part, int begin, int end )
+	{
+		Q_UNUSED( part );
+		for(int i = begin; i < end; ++i)
+			m_failed[i] = !layout( m_files.at(i), &m_reports[i] );
+	}
+
+	const QVector<QString>& reports() const { return m_reports; }
+	const QVector<bool>& failed() const { return m_failed; }
+
+private:
+	bool read( const QString &fileName, GraphCore *core,
+	           QVector<QString> *labels, QString *report );
+	bool layout( const QString &fileName, QString *report );
+
+	Settings m_settings;
+	QStringList m_files;
+	//sized up front, each job only touches its own entry
+	QVector<QString> m_reports;
+	QVector<bool> m_failed;
+};
+
+bool BatchTask::read( const QString &fileName, GraphCore *core,
+                      QVector<QString> *labels, QString *report )
+{
+	if( BinaryGraph::isBinaryGraph( fileName ) ) {
+		BinaryGraph file;
+		if( !file.open( fileName ) || !file.load( core, labels ) ) {
+			*report = file.errorString() + "\n";
+			return false;
+		}
+		return true;
+	}
+	GraphReader reader;
+	if( !reader.readFile( fileName ) ) {
+		*report = reader.errors().join( "\n" ) + "\n";
+		return false;
+	}
+	reader.build( core, labels );
+	QStringList errors = reader.errors();
+	for(int i = 0; i < errors.size(); ++i)
+		*report += fileName + ": " + errors.at(i) + "\n";
+	return true;
+}
+
+bool BatchTask::layout( const QString &fileName, QString *report )
+{
+	QTime time;
+	time.start();
+	GraphCore core;
+	QVector<QString> labels;
+	if( !read( fileName, &core, &labels, report ) )
+		return false;
+
+	Graph g( core, labels );
+	g.setLayoutThreads( m_settings.threads );
+	g.setRandomSeed( m_settings.seed );
+	QString baseName = outputBase( m_settings, fileName );
+	QFile recordFile( baseName + ".telemetry.csv" );
+	QTextStream recordStream( &recordFile );
+	CsvTelemetry telemetry( &recordStream );
+	if( m_settings.record ) {
+		if( !recordFile.open( QIODevice::WriteOnly | QIODevice::Text ) ) {
+			*report += recordFile.fileName() + ": "
+			           + recordFile.errorString() + "\n";
+			return false;
+		}
+		CsvTelemetry::writeHeader( &recordStream );
+		g.setTelemetry( &telemetry );
+	}
+	int iterations = m_settings.iterations;
+	switch( m_settings.algorithm ) {
+	case Graph::NGon:
+		g.layoutNGon();
+		break;
+	case Graph::Random:
+		g.layoutRandom( 100.0 );
+		break;
+	case Graph::KamadaKawai:
+		if( !g.layoutKamadaKawai( iterations < 0 ? 100 : iterations,
+		                          m_settings.epsilon, m_settings.initialize ) ) {
+			*report += fileName + ": too large for the distances of all "
+			           "pairs, use multilevel or stress\n";
+			return false;
+		}
+		break;
+	case Graph::Multilevel:
+		g.layoutMultilevel( iterations < 0 ? 50 : iterations );
+		break;
+	case Graph::StressSGD:
+		g.layoutStressSGD( iterations < 0 ? 30 : iterations,
+		                   m_settings.pivots, m_settings.initialize );
+		break;
+	case Graph::FruchtermanReingold:
+		g.layoutFruchtermanReingold( iterations < 0 ? 200 : iterations,
+		                             m_settings.epsilon,
+		                             m_settings.initialize );
+		break;
+	}
+
+	QString outName = baseName + ".layout"
+	                  + ( m_settings.binary ? ".kfb" : ".dot" );
+	if( m_settings.binary ) {
+		QString error;
+		if( !BinaryGraph::write( outName, *g.core(), labels, &error ) ) {
+			*report += error + "\n";
+			return false;
+		}
+	} else {
+		QFile outfile( outName );
+		if( !outfile.open( QIODevice::WriteOnly | QIODevice::Text ) ) {
+			*report += outName + ": " + outfile.errorString() + "\n";
+			return false;
+		}
+		QTextStream ostream( &outfile );
+		Graph::writeGraph( &ostream, &g );
+	}
+	*report += QString( "%1: %2 vertices, %3 edges, %4 ms -> %5\n" )
+	           .arg( fileName ).arg( core.size() ).arg( core.edgeCount() )
+	           .arg( time.elapsed() ).arg( outName );
+	if( m_settings.quality ) {
+		WorkerPool pool( m_settings.threads );
+		LayoutQuality quality( g.core(), &pool );
+		quality.setSeed( m_settings.seed );
+		//the sweep still tests about m² pairs on a tangled layout
+		int metrics = LayoutQuality::Distances | LayoutQuality::EdgeLengths;
+		if( core.edgeCount() <= m_settings.maxCrossingEdges )
+			metrics |= LayoutQuality::Crossings;
+		quality.compute( metrics );
+		QString crossings = quality.crossings() < 0
+		                    ? QString( "uncounted" )
+		                    : QString::number( quality.crossings() );
+		*report += QString( "%1: stress %2%3, energy %4, edge length spread "
+		                    "%5, %6 crossings\n" )
+		           .arg( fileName ).arg( quality.stress() )
+		           .arg( quality.isSampled() ? " (sampled)" : "" )
+		           .arg( quality.energy() ).arg( quality.edgeLengthSpread() )
+		           .arg( crossings );
+	}
+	return true;
+}
+
+/* @return true if @p name was understood */
+static bool parseAlgorithm( const QString &name, Graph::LayoutAlgorithm *a )
+{
+	static const char *names[] = { "ngon", "random", "kamadakawai",
+	                               "multilevel", "stress",
+	                               "fruchtermanreingold" };
+	static const Graph::LayoutAlgorithm algorithms[] = { Graph::NGon,
+		Graph::Random, Graph::KamadaKawai, Graph::Multilevel,
+		Graph::StressSGD, Graph::FruchtermanReingold };
+	for(int i = 0; i < 6; ++i)
+		if( name == names[i] ) {
+			*a = algorithms[i];
+			return true;
+		}
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc,argv);
+	QStringList args = app.arguments();
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+
+	Settings settings;
+	settings.algorithm = Graph::KamadaKawai;
+	settings.iterations = -1;
+	settings.epsilon = 0.0000001;
+	settings.pivots = -1;
+	settings.initialize = true;
+	settings.seed = 0;
+	settings.threads = 1;
+	settings.output = ".";
+	settings.binary = false;
+	settings.quality = false;
+	settings.maxCrossingEdges = 20000;
+	settings.record = false;
+	int jobs = 0;
+
+	QStringList files;
+	for(int i = 1; i < args.size(); ++i) {
+		QString arg = args.at(i);
+		bool ok = true;
+		//the options that take a value
+		if( arg.startsWith("-") && arg != "-k" && arg != "--keep"
+		    && arg != "-b" && arg != "--binary"
+		    && arg != "-q" && arg != "--quality"
+		    && arg != "-r" && arg != "--record" ) {
+			if( i + 1 >= args.size() ) {
+				err << arg << " needs a value\n" << USAGE;
+				return 2;
+			}
+			QString value = args.at(++i);
+			if( arg == "-a" || arg == "--algorithm" )
+				ok = parseAlgorithm( value, &settings.algorithm );
+			else if( arg == "-i" || arg == "--iterations" )
+				settings.iterations = value.toInt(&ok);
+			else if( arg == "-e" || arg == "--epsilon" )
+				settings.epsilon = value.toDouble(&ok);
+			else if( arg == "-p" || arg == "--pivots" )
+				settings.pivots = value.toInt(&ok);
+			else if( arg == "-s" || arg == "--seed" )
+				settings.seed = value.toULongLong(&ok);
+			else if( arg == "-j" || arg == "--jobs" )
+				jobs = value.toInt(&ok);
+			else if( arg == "-t" || arg == "--threads" )
+				settings.threads = value.toInt(&ok);
+			else if( arg == "-o" || arg == "--output" )
+				settings.output = value;
+			else if( arg == "-c" || arg == "--max-crossings" )
+				settings.maxCrossingEdges = value.toInt(&ok);
+			else
+				ok = false;
+			if( !ok ) {
+				err << "bad option " << arg << " " << value << "\n" << USAGE;
+				return 2;
+			}
+		} else if( arg == "-k" || arg == "--keep" ) {
+			settings.initialize = false;
+		} else if( arg == "-b" || arg == "--binary" ) {
+			settings.binary = true;
+		} else if( arg == "-q" || arg == "--quality" ) {
+			settings.quality = true;
+		} else if( arg == "-r" || arg == "--record" ) {
+			settings.record = true;
+		} else {
+			files.append( arg );
+		}
+	}
+	if( files.isEmpty() ) {
+		err << USAGE;
+		return 2;
+	}
+	//the jobs run at once, so one would overwrite the other's results
+	QMap<QString,QString> outputs;
+	for(int i = 0; i < files.size(); ++i) {
+		QString base = QFileInfo( outputBase( settings, files.at(i) ) )
+		               .absoluteFilePath();
+		if( outputs.contains( base ) ) {
+			err << files.at(i) << " and " << outputs.value( base )
+			    << " would both be written to " << base << ".layout.*\n";
+			return 2;
+		}
+		outputs.insert( base, files.at(i) );
+	}
+
+	BatchTask task( settings, files );
+	WorkerPool pool( jobs );
+	pool.runEach( &task, files.size() );
+
+	int failed = 0;
+	for(int i = 0; i < files.size(); ++i) {
+		if( task.failed().at(i) ) {
+			err << task.reports().at(i);
+			++failed;
+		} else {
+			out << task.reports().at(i);
+		}
+	}
+	if( failed )
+		err << failed << " of " << files.size() << " files failed\n";
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,413 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+/*
+ * Times reading, writing, building and laying out synthetic graphs of
+ * several kinds and sizes, and writes the times as JSON or CSV so they can
+ * be compared from run to run. Every layout also gets its quality
+ * measured, so a faster layout can be weighed against a better one.
+ * Everything is headless.
+ */
+
+#include <cmath>
+#include <cstdio>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QTextStream>
+#include <QtCore/QVector>
+
+#include "BinaryGraph.h"
+#include "Graph.h"
+#include "GraphCore.h"
+#include "GraphGenerator.h"
+#include "GraphReader.h"
+#include "LayoutQuality.h"
+#include "RandomGenerator.h"
+#include "WorkerPool.h"
+
+static const char USAGE[] =
+"usage: kfbbench [options]\n"
+"  -g, --generators LIST  er, ba, grid, clusters; default all\n"
+"  -n, --sizes LIST       vertex counts, default 100,1000,10000,100000\n"
+"  -a, --algorithms LIST  ngon, random, kamadakawai, multilevel, stress,\n"
+"                         fruchtermanreingold; default all\n"
+"  -m, --max-all-pairs N  skip kamadakawai above N vertices, default 5000\n"
+"  -c, --max-crossings N  count crossings up to N edges, default 20000\n"
+"  -d, --degree D         average degree of er and clusters, default 4\n"
+"  -l, --links N          edges per new vertex of ba, default 3\n"
+"  -t, --threads N        threads per layout, 0 = one per core (default)\n"
+"  -s, --seed N           seed of the generators and layouts\n"
+"  -f, --format FORMAT    json (default) or csv\n"
+"  -o, --output FILE      where to write the results, default stdout\n";
+
+static const char *ALGORITHMNAMES[] = { "ngon", "random", "kamadakawai",
+                                        "multilevel", "stress",
+                                        "fruchtermanreingold" };
+static const Graph::LayoutAlgorithm ALGORITHMS[] = { Graph::NGon,
+	Graph::Random, Graph::KamadaKawai, Graph::Multilevel, Graph::StressSGD,
+	Graph::FruchtermanReingold };
+static const int ALGORITHMCOUNT = 6;
+
+/// one timed step
+struct Result {
+	QString generator;
+	int vertices;
+	int edges;
+	QString stage;
+	QString algorithm; ///< empty unless stage is layout
+	double ms;
+	/// the quality of a layout, see LayoutQuality, -1 if not measured
+	double stress;
+	double energy;
+	double spread;
+	qint64 crossings;
+};
+
+struct Settings {
+	QStringList generators;
+	QList<int> sizes;
+	QList<Graph::LayoutAlgorithm> algorithms;
+	int maxAllPairs;
+	int maxCrossingEdges;
+	qreal degree;
+	int links;
+	int threads;
+	quint64 seed;
+};
+
+static double milliseconds( const QElapsedTimer &timer )
+{
+	return timer.nsecsElapsed() / 1e6;
+}
+
+class Bench
+{
+public:
+	Bench( const Settings &settings ) : m_settings( settings ) {}
+
+	/** times every generator at every size */
+	void run();
+	const QList<Result>& results() const { return m_results; }
+
+private:
+	void runGraph( const QString &generator, int n );
+	void record( const QString &stage, const QString &algorithm, double ms,
+	             const LayoutQuality *quality = 0 );
+	void layout( const GraphCore &core, const QVector<QString> &labels,
+	             Graph::LayoutAlgorithm algorithm );
+
+	Settings m_settings;
+	QList<Result> m_results;
+	QString m_generator;
+	int m_vertices;
+	int m_edges;
+};
+
+void Bench::run()
+{
+	for(int g = 0; g < m_settings.generators.size(); ++g)
+		for(int s = 0; s < m_settings.sizes.size(); ++s)
+			runGraph( m_settings.generators.at(g), m_settings.sizes.at(s) );
+}
+
+void Bench::record( const QString &stage, const QString &algorithm, double ms,
+                    const LayoutQuality *quality )
+{
+	Result r;
+	r.generator = m_generator;
+	r.vertices = m_vertices;
+	r.edges = m_edges;
+	r.stage = stage;
+	r.algorithm = algorithm;
+	r.ms = ms;
+	r.stress = quality ? quality->stress() : -1.0;
+	r.energy = quality ? quality->energy() : -1.0;
+	r.spread = quality ? quality->edgeLengthSpread() : -1.0;
+	r.crossings = quality ? quality->crossings() : -1;
+	m_results.append( r );
+	//progress for whoever is watching, the results go to the output
+	QTextStream err(stderr);
+	err << r.generator << " " << r.vertices << ": " << r.stage << " "
+	    << r.algorithm << " " << QString::number( ms, 'f', 3 ) << " ms";
+	if( quality )
+		err << ", stress " << r.stress << ", crossings " << r.crossings;
+	err << "\n";
+}
+
+void Bench::runGraph( const QString &generator, int n )
+{
+	RandomGenerator random( m_settings.seed );
+	GraphGenerator generate( &random );
+	QElapsedTimer timer;
+
+	timer.start();
+	GraphGenerator::EdgeList edges;
+	if( generator == "er" ) {
+		edges = generate.erdosRenyi( n, m_settings.degree );
+	} else if( generator == "ba" ) {
+		edges = generate.barabasiAlbert( n, m_settings.links );
+	} else if( generator == "grid" ) {
+		int width = qMax( 1, (int)sqrt( (double)n ) );
+		n = width * width;
+		edges = generate.grid( width, width );
+	} else {
+		edges = generate.clusters( n, qMax( 2, n / 100 ), m_settings.degree );
+	}
+	double generateTime = milliseconds( timer );
+	m_generator = generator;
+	m_vertices = n;
+	m_edges = edges.size();
+	record( "generate", QString(), generateTime );
+
+	//building the core includes its first look at the rows
+	timer.start();
+	GraphCore core;
+	QVector<QString> labels;
+	GraphGenerator::fill( &core, &labels, n, edges );
+	core.offsets();
+	record( "construct", QString(), milliseconds( timer ) );
+
+	QTemporaryFile text;
+	if( text.open() ) {
+		timer.start();
+		QTextStream stream( &text );
+		Graph::writeGraph( &stream, core, labels );
+		stream.flush();
+		text.flush();
+		record( "write_text", QString(), milliseconds( timer ) );
+
+		timer.start();
+		GraphReader reader;
+		GraphCore read;
+		QVector<QString> readLabels;
+		reader.readFile( text.fileName() );
+		reader.build( &read, &readLabels );
+		record( "read_text", QString(), milliseconds( timer ) );
+	}
+
+	QTemporaryFile binary;
+	if( binary.open() ) {
+		timer.start();
+		BinaryGraph::write( binary.fileName(), core, labels );
+		record( "write_binary", QString(), milliseconds( timer ) );
+
+		timer.start();
+		BinaryGraph file;
+		GraphCore read;
+		QVector<QString> readLabels;
+		if( file.open( binary.fileName() ) )
+			file.load( &read, &readLabels );
+		record( "read_binary", QString(), milliseconds( timer ) );
+	}
+
+	for(int a = 0; a < m_settings.algorithms.size(); ++a) {
+		Graph::LayoutAlgorithm algorithm = m_settings.algorithms.at(a);
+		//the all-pairs distance matrix takes n² memory
+		if( algorithm == Graph::KamadaKawai && n > m_settings.maxAllPairs )
+			continue;
+		layout( core, labels, algorithm );
+	}
+}
+
+void Bench::layout( const GraphCore &core, const QVector<QString> &labels,
+                    Graph::LayoutAlgorithm algorithm )
+{
+	Graph g( core, labels );
+	g.setLayoutThreads( m_settings.threads );
+	g.setRandomSeed( m_settings.seed );
+
+	QElapsedTimer timer;
+	timer.start();
+	switch( algorithm ) {
+	case Graph::NGon:
+		g.layoutNGon();
+		break;
+	case Graph::Random:
+		g.layoutRandom( 100.0 );
+		break;
+	case Graph::KamadaKawai:
+		if( !g.layoutKamadaKawai( 100, 0.0000001, true ) )
+			return;
+		break;
+	case Graph::Multilevel:
+		g.layoutMultilevel( 50 );
+		break;
+	case Graph::StressSGD:
+		g.layoutStressSGD( 30, -1, true );
+		break;
+	case Graph::FruchtermanReingold:
+		g.layoutFruchtermanReingold( 200, 0.0000001, true );
+		break;
+	}
+	double ms = milliseconds( timer );
+
+	WorkerPool pool( m_settings.threads );
+	LayoutQuality quality( g.core(), &pool );
+	quality.setSeed( m_settings.seed );
+	//the sweep still tests about m² pairs on a tangled layout
+	int metrics = LayoutQuality::Distances | LayoutQuality::EdgeLengths;
+	if( core.edgeCount() <= m_settings.maxCrossingEdges )
+		metrics |= LayoutQuality::Crossings;
+	quality.compute( metrics );
+
+	for(int a = 0; a < ALGORITHMCOUNT; ++a)
+		if( ALGORITHMS[a] == algorithm )
+			record( "layout", ALGORITHMNAMES[a], ms, &quality );
+}
+
+/* @return @p value for the output, empty if it wasn't measured */
+static QString measured( double value )
+{
+	//the energy is infinite when two vertices are in the same place
+	if( value < 0.0 || value != value || value > 1e300 )
+		return QString();
+	return QString::number( value, 'g', 6 );
+}
+
+static QString measured( qint64 value )
+{
+	return value < 0 ? QString() : QString::number( value );
+}
+
+/* @return @p text for JSON, null if it is empty */
+static QString jsonValue( const QString &text )
+{
+	return text.isEmpty() ? QString( "null" ) : text;
+}
+
+static void writeJson( QTextStream *out, const QList<Result> &results )
+{
+	*out << "[\n";
+	for(int i = 0; i < results.size(); ++i) {
+		const Result &r = results.at(i);
+		*out << "  {\"generator\": \"" << r.generator << "\", \"vertices\": "
+		     << r.vertices << ", \"edges\": " << r.edges << ", \"stage\": \""
+		     << r.stage << "\", \"algorithm\": \"" << r.algorithm
+		     << "\", \"ms\": " << QString::number( r.ms, 'f', 3 )
+		     << ", \"stress\": " << jsonValue( measured( r.stress ) )
+		     << ", \"energy\": " << jsonValue( measured( r.energy ) )
+		     << ", \"spread\": " << jsonValue( measured( r.spread ) )
+		     << ", \"crossings\": " << jsonValue( measured( r.crossings ) )
+		     << "}" << ( i + 1 < results.size() ? ",\n" : "\n" );
+	}
+	*out << "]\n";
+}
+
+static void writeCsv( QTextStream *out, const QList<Result> &results )
+{
+	*out << "generator,vertices,edges,stage,algorithm,ms,stress,energy,"
+	        "spread,crossings\n";
+	for(int i = 0; i < results.size(); ++i) {
+		const Result &r = results.at(i);
+		*out << r.generator << "," << r.vertices << "," << r.edges << ","
+		     << r.stage << "," << r.algorithm << ","
+		     << QString::number( r.ms, 'f', 3 ) << ","
+		     << measured( r.stress ) << "," << measured( r.energy ) << ","
+		     << measured( r.spread ) << "," << measured( r.crossings ) << "\n";
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc,argv);
+	QStringList args = app.arguments();
+	QTextStream err(stderr);
+
+	Settings settings;
+	settings.generators << "er" << "ba" << "grid" << "clusters";
+	settings.sizes << 100 << 1000 << 10000 << 100000;
+	for(int a = 0; a < ALGORITHMCOUNT; ++a)
+		settings.algorithms << ALGORITHMS[a];
+	settings.maxAllPairs = 5000;
+	settings.maxCrossingEdges = 20000;
+	settings.degree = 4.0;
+	settings.links = 3;
+	settings.threads = 0;
+	settings.seed = 21184;
+	QString format = "json";
+	QString output;
+
+	for(int i = 1; i < args.size(); ++i) {
+		QString arg = args.at(i);
+		if( i + 1 >= args.size() ) {
+			err << USAGE;
+			return 2;
+		}
+		QString value = args.at(++i);
+		bool ok = true;
+		if( arg == "-g" || arg == "--generators" ) {
+			settings.generators = value.split(",");
+			for(int g = 0; g < settings.generators.size(); ++g)
+				ok = ok && QString("er ba grid clusters").split(" ")
+				                  .contains( settings.generators.at(g) );
+		} else if( arg == "-n" || arg == "--sizes" ) {
+			settings.sizes.clear();
+			QStringList sizes = value.split(",");
+			for(int s = 0; ok && s < sizes.size(); ++s)
+				settings.sizes << sizes.at(s).toInt(&ok);
+		} else if( arg == "-a" || arg == "--algorithms" ) {
+			settings.algorithms.clear();
+			QStringList names = value.split(",");
+			for(int n = 0; ok && n < names.size(); ++n) {
+				ok = false;
+				for(int a = 0; a < ALGORITHMCOUNT; ++a)
+					if( names.at(n) == ALGORITHMNAMES[a] ) {
+						settings.algorithms << ALGORITHMS[a];
+						ok = true;
+					}
+			}
+		} else if( arg == "-m" || arg == "--max-all-pairs" ) {
+			settings.maxAllPairs = value.toInt(&ok);
+		} else if( arg == "-c" || arg == "--max-crossings" ) {
+			settings.maxCrossingEdges = value.toInt(&ok);
+		} else if( arg == "-d" || arg == "--degree" ) {
+			settings.degree = value.toDouble(&ok);
+		} else if( arg == "-l" || arg == "--links" ) {
+			settings.links = value.toInt(&ok);
+		} else if( arg == "-t" || arg == "--threads" ) {
+			settings.threads = value.toInt(&ok);
+		} else if( arg == "-s" || arg == "--seed" ) {
+			settings.seed = value.toULongLong(&ok);
+		} else if( arg == "-f" || arg == "--format" ) {
+			format = value;
+			ok = format == "json" || format == "csv";
+		} else if( arg == "-o" || arg == "--output" ) {
+			output = value;
+		} else {
+			ok = false;
+		}
+		if( !ok ) {
+			err << "bad option " << arg << " " << value << "\n" << USAGE;
+			return 2;
+		}
+	}
+
+	Bench bench( settings );
+	bench.run();
+
+	QFile outfile( output );
+	bool opened = output.isEmpty()
+	              ? outfile.open( stdout, QIODevice::WriteOnly )
+	              : outfile.open( QIODevice::WriteOnly | QIODevice::Text );
+	if( !opened ) {
+		err << output << ": " << outfile.errorString() << "\n";
+		return 1;
+	}
+	QTextStream out( &outfile );
+	if( format == "csv" )
+		writeCsv( &out, bench.results() );
+	else
+		writeJson( &out, bench.results() );
+	return 0;
+}
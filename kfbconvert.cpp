@@ -0,0 +1,71 @@
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+//
+// Copyright 2008 Henry de Valence <hdevalence@gmail.com>
+
+/*
+ * Converts between the text format of Graph::readGraph and the binary
+ * format of BinaryGraph: a binary input is written as text, anything else
+ * is read as text and written as binary. No graphics items are made.
+ */
+
+#include <cstdio>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+#include <QtCore/QVector>
+
+#include "BinaryGraph.h"
+#include "Graph.h"
+#include "GraphCore.h"
+#include "GraphReader.h"
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc,argv);
+	QStringList args = app.arguments();
+	QTextStream err(stderr);
+	if( args.size() != 3 ) {
+		err << "usage: kfbconvert INPUT OUTPUT\n";
+		return 2;
+	}
+
+	GraphCore core;
+	QVector<QString> labels;
+	if( BinaryGraph::isBinaryGraph(args.at(1)) ) {
+		BinaryGraph in;
+		if( !in.open(args.at(1)) || !in.load(&core, &labels) ) {
+			err << in.errorString() << "\n";
+			return 1;
+		}
+		QFile outfile(args.at(2));
+		if( !outfile.open(QIODevice::WriteOnly|QIODevice::Text) ) {
+			err << args.at(2) << ": " << outfile.errorString() << "\n";
+			return 1;
+		}
+		QTextStream ostream(&outfile);
+		Graph::writeGraph(&ostream, core, labels);
+	} else {
+		GraphReader reader;
+		if( !reader.readFile(args.at(1)) ) {
+			err << reader.errors().join("\n") << "\n";
+			return 1;
+		}
+		reader.build(&core, &labels);
+		QStringList errors = reader.errors();
+		for(int i = 0; i < errors.size(); ++i)
+			err << args.at(1) << ": " << errors.at(i) << "\n";
+		QString error;
+		if( !BinaryGraph::write(args.at(2), core, labels, &error) ) {
+			err << error << "\n";
+			return 1;
+		}
+	}
+	return 0;
+}
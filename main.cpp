@@ -7,37 +7,56 @@
 #include <QtCore/QFile>
 #include <QtCore/QTextStream>
 
+#include "BackgroundLayout.h"
+#include "EdgeLayer.h"
 #include "Graph.h"
+#include "GraphViewport.h"
 #include "Vertex.h"
 #include "Edge.h"
 
+// graphs with more vertices than this only get items for the visible ones
+static const int VIRTUALLIMIT = 20000;
+
+/* Fits the view around the graph once the layout is done */
+class FittingLayout : public BackgroundLayout
+{
+public:
+	FittingLayout( Graph *g, QGraphicsView *view )
+	    : BackgroundLayout( g ), m_view( view ) {}
+protected:
+	void frameApplied( bool finished )
+	{
+		if( finished )
+			m_view->fitInView( m_view->scene()->sceneRect(),
+			                   Qt::KeepAspectRatio );
+	}
+private:
+	QGraphicsView *m_view;
+};
+
 int main(int argc, char *argv[])
 {
 	QApplication app(argc,argv);
 	QStringList args = app.arguments();
-	QFile infile(args.at(1));
-	infile.open(QIODevice::ReadOnly|QIODevice::Text);
-	QTextStream istream(&infile);
-	Graph *g = Graph::readGraph(&istream);
+	Graph *g = Graph::readHeadlessGraph(args.at(1), 0);
+	if( !g )
+		return 1;
+	//small graphs get an item for every vertex
+	bool virtualized = g->core()->size() > VIRTUALLIMIT;
+	if( !virtualized ) {
+		Graph *items = Graph::fromCore( *g->core(), g->labels() );
+		delete g;
+		g = items;
+	}
 
 
 	QGraphicsScene *s = new QGraphicsScene();
 
-	//get a copy to use a bunch of times
-	QMap<uint,Vertex*> vertices = g->vertices();
-	for(QMap<uint,Vertex*>::const_iterator i = vertices.constBegin();
-	    i != vertices.constEnd(); ++i )
-	{
-		s->addItem(*i);
-	}
+	for(int i = 0; i < g->vertexItems().size(); ++i)
+		s->addItem( g->vertexItems().at(i) );
 
-	//get a copy to use a bunch of times
-	QMap<QPair<Vertex*, Vertex*>, Edge*> edges = g->edges();
-	for(QMap<QPair<Vertex*, Vertex*>, Edge*>::const_iterator i =
-	    edges.constBegin(); i != edges.constEnd(); ++i )
-	{
-		s->addItem(*i);
-	}
+	//one item draws all the edges
+	s->addItem( new EdgeLayer( g ) );
 
 	QGraphicsView *view = new QGraphicsView(s);
 	view->resize(700, 900);
@@ -45,11 +64,16 @@ int main(int argc, char *argv[])
 	view->show();
 	//view->scale(5,5);
 
+	//only the vertices in sight get items
+	GraphViewport *viewport = virtualized ? new GraphViewport( g, view ) : 0;
 
-	//g->layoutNGon();
-	g->layoutKamadaKawai(100,0.0000001,true);
 
-	view->fitInView( view->scene()->sceneRect(),Qt::KeepAspectRatio);
+	//g->layoutNGon();
+	//the layout runs on its own thread, the view shows its progress.
+	//Kamada-Kawai is quadratic, large graphs keep the positions they have
+	FittingLayout layout( g, view );
+	if( !virtualized )
+		layout.startKamadaKawai(100,0.0000001,true);
 
 #if 0
 	QFile outfile(args.at(2));
@@ -58,5 +82,8 @@ int main(int argc, char *argv[])
 	Graph::writeGraph(&ostream, g);
 #endif
 
-	return app.exec();
+	int result = app.exec();
+	//it still watches the view
+	delete viewport;
+	return result;
 }